@@ -4,6 +4,11 @@
 
 #define DT_DRV_COMPAT maxim_max30102
 
+#include <string.h>
+
+#include <zephyr/pm/device.h>
+#include <zephyr/pm/device_runtime.h>
+
 #include "zephyr/logging/log.h"
 
 #include "max30102.h"
@@ -11,35 +16,304 @@
 LOG_MODULE_REGISTER(MAX30102, CONFIG_SENSOR_LOG_LEVEL);
 
 
-static int max30102_sample_fetch(const struct device *dev, enum sensor_channel chan)
+/*
+ * Read the pending samples, up to max_samples, from the FIFO into buffer.
+ * Returns the number of samples read.
+ */
+int max30102_fifo_drain(const struct device *dev, uint8_t *buffer, uint16_t max_samples, uint8_t *overflow)
 {
     struct max30102_data *data = dev->data;
     const struct max30102_config *config = dev->config;
-    uint8_t buffer[MAX30102_MAX_BYTES_PER_SAMPLE];
-    uint32_t fifo_data;
-    int fifo_chan;
+    uint8_t fifo_ptr[3];
+    int num_samples;
     int num_bytes;
-    int i;
 
-    /* Read all the active channels for one sample */
-    num_bytes = data->num_channels * MAX30102_BYTES_PER_CHANNEL;
+    /* Read the FIFO write, overflow and read pointers in one transaction */
+    if (i2c_burst_read_dt(&config->i2c, MAX30102_REG_FIFO_WR, fifo_ptr, sizeof(fifo_ptr)))
+    {
+        LOG_ERR("Could not read FIFO pointers");
+        return -EIO;
+    }
+
+    num_samples = (fifo_ptr[0] - fifo_ptr[2]) & MAX30102_FIFO_PTR_MASK;
+    if ((num_samples == 0) && (fifo_ptr[1] != 0))
+    {
+        /* Equal pointers with lost samples mean the FIFO is full */
+        num_samples = MAX30102_FIFO_DEPTH;
+    }
+
+    if (overflow != NULL)
+    {
+        *overflow = fifo_ptr[1];
+    }
+
+    num_samples = MIN(num_samples, max_samples);
+    if (num_samples == 0)
+    {
+        return 0;
+    }
+
+    /* Drain all the pending samples in a single burst */
+    num_bytes = num_samples * data->num_channels * MAX30102_BYTES_PER_CHANNEL;
     if (i2c_burst_read_dt(&config->i2c, MAX30102_REG_FIFO_DATA, buffer, num_bytes))
     {
         LOG_ERR("Could not fetch sample");
         return -EIO;
     }
 
-    fifo_chan = 0;
-    for (i = 0; i < num_bytes; i += 3)
+    return num_samples;
+}
+
+void max30102_fifo_unpack(const uint8_t *buffer, uint8_t num_channels, uint32_t *const *dest, int num_samples)
+{
+    for (int sample = 0; sample < num_samples; sample++)
+    {
+        for (int fifo_chan = 0; fifo_chan < num_channels; fifo_chan++)
+        {
+            if (dest[fifo_chan] != NULL)
+            {
+                dest[fifo_chan][sample] = max30102_fifo_word(buffer);
+            }
+            buffer += MAX30102_BYTES_PER_CHANNEL;
+        }
+    }
+}
+
+int max30102_fifo_read(const struct device *dev, uint32_t *red, uint32_t *ir, uint16_t max_samples,
+    uint8_t *overflow)
+{
+    struct max30102_data *data = dev->data;
+    uint32_t *dest[MAX30102_MAX_NUM_CHANNELS] = {NULL};
+    int num_samples;
+
+    /* Route each fifo channel straight to the caller array of its led */
+    if (data->map[MAX30102_LED_CHANNEL_RED] < MAX30102_MAX_NUM_CHANNELS)
+    {
+        dest[data->map[MAX30102_LED_CHANNEL_RED]] = red;
+    }
+    if (data->map[MAX30102_LED_CHANNEL_IR] < MAX30102_MAX_NUM_CHANNELS)
     {
-        /* Each channel is 18-bits */
-        fifo_data = (buffer[i] << 16) | (buffer[i + 1] << 8) | (buffer[i + 2]);
-        fifo_data &= MAX30102_FIFO_DATA_MASK;
+        dest[data->map[MAX30102_LED_CHANNEL_IR]] = ir;
+    }
 
-        /* Save the raw data */
-        data->raw[fifo_chan++] = fifo_data;
+    num_samples = max30102_fifo_drain(dev, data->fifo_buf, max_samples, overflow);
+    if (num_samples <= 0)
+    {
+        return num_samples;
     }
 
+    max30102_fifo_unpack(data->fifo_buf, data->num_channels, dest, num_samples);
+
+    return num_samples;
+}
+
+int max30102_fifo_flush(const struct device *dev)
+{
+    const struct max30102_config *config = dev->config;
+    uint8_t fifo_ptr[3] = {0};
+
+    return i2c_burst_write_dt(&config->i2c, MAX30102_REG_FIFO_WR, fifo_ptr, sizeof(fifo_ptr)) ? -EIO : 0;
+}
+
+static int max30102_die_temp_trigger(const struct device *dev)
+{
+    const struct max30102_config *config = dev->config;
+
+    if (i2c_reg_write_byte_dt(&config->i2c, MAX30102_REG_TEMP_CFG, MAX30102_TEMP_CFG_TEMP_EN_MASK))
+    {
+        LOG_ERR("Could not start the die temperature conversion");
+        return -EIO;
+    }
+
+    return 0;
+}
+
+/*
+ * Read back the result of a triggered conversion. Returns -EAGAIN while
+ * the conversion is still running.
+ */
+static int max30102_die_temp_read(const struct device *dev)
+{
+    struct max30102_data *data = dev->data;
+    const struct max30102_config *config = dev->config;
+    uint8_t temp_cfg;
+    uint8_t temp[2];
+
+    if (i2c_reg_read_byte_dt(&config->i2c, MAX30102_REG_TEMP_CFG, &temp_cfg))
+    {
+        return -EIO;
+    }
+
+    /* TEMP_EN clears itself once the conversion is done */
+    if (temp_cfg & MAX30102_TEMP_CFG_TEMP_EN_MASK)
+    {
+        return -EAGAIN;
+    }
+
+    /* TINT and TFRAC are adjacent */
+    if (i2c_burst_read_dt(&config->i2c, MAX30102_REG_TINT, temp, sizeof(temp)))
+    {
+        LOG_ERR("Could not read the die temperature");
+        return -EIO;
+    }
+
+    data->die_temp = (int16_t)((int8_t)temp[0] * 16) + (temp[1] & 0x0f);
+
+    return 0;
+}
+
+static int max30102_die_temp_convert(const struct device *dev)
+{
+    int attempts = 0;
+    int err;
+
+    if (max30102_die_temp_trigger(dev))
+    {
+        return -EIO;
+    }
+
+    do
+    {
+        if (attempts++ >= MAX30102_DIE_TEMP_READOUT_ATTEMPTS)
+        {
+            LOG_ERR("Die temperature conversion timed out");
+            return -EIO;
+        }
+
+        k_sleep(K_MSEC(MAX30102_DIE_TEMP_POLL_MS));
+
+        err = max30102_die_temp_read(dev);
+    } while (err == -EAGAIN);
+
+    return err;
+}
+
+static int max30102_die_temp_fetch(const struct device *dev)
+{
+    int err;
+
+    /* The conversion does not run in shutdown */
+    err = pm_device_runtime_get(dev);
+    if (err < 0)
+    {
+        return err;
+    }
+
+    err = max30102_die_temp_convert(dev);
+
+    (void)pm_device_runtime_put(dev);
+
+    return err;
+}
+
+static void max30102_die_temp_work_cb(struct k_work *work)
+{
+    struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+    struct max30102_data *data = CONTAINER_OF(dwork, struct max30102_data, die_temp_work);
+    max30102_die_temp_cb_t cb = data->die_temp_cb;
+    int err;
+
+    /* Poll the result without ever sleeping on the work queue */
+    err = max30102_die_temp_read(data->dev);
+
+    if ((err == -EAGAIN) && (data->die_temp_attempts++ < MAX30102_DIE_TEMP_READOUT_ATTEMPTS))
+    {
+        k_work_reschedule_for_queue(data->work_q, &data->die_temp_work, K_MSEC(MAX30102_DIE_TEMP_POLL_MS));
+        return;
+    }
+
+    if (err)
+    {
+        LOG_ERR("Die temperature conversion failed");
+        err = -EIO;
+    }
+
+    data->die_temp_cb = NULL;
+    (void)pm_device_runtime_put(data->dev);
+
+    cb(data->dev, err, data->die_temp_user_data);
+}
+
+int max30102_die_temp_start(const struct device *dev, max30102_die_temp_cb_t cb, void *user_data)
+{
+    struct max30102_data *data = dev->data;
+
+    if (cb == NULL)
+    {
+        return -EINVAL;
+    }
+
+    if (data->die_temp_cb != NULL)
+    {
+        return -EBUSY;
+    }
+
+    /* Released once the conversion completed or failed */
+    if (pm_device_runtime_get(dev) < 0)
+    {
+        return -EIO;
+    }
+
+    if (max30102_die_temp_trigger(dev))
+    {
+        (void)pm_device_runtime_put(dev);
+        return -EIO;
+    }
+
+    /* The first poll is when the datasheet says the conversion is done */
+    data->die_temp_cb = cb;
+    data->die_temp_user_data = user_data;
+    data->die_temp_attempts = 0;
+    k_work_schedule_for_queue(data->work_q, &data->die_temp_work, K_MSEC(MAX30102_DIE_TEMP_CONV_MS));
+
+    return 0;
+}
+
+void max30102_work_queue_set(const struct device *dev, struct k_work_q *queue)
+{
+    struct max30102_data *data = dev->data;
+
+    data->work_q = (queue != NULL) ? queue : &k_sys_work_q;
+}
+
+static int max30102_sample_fetch(const struct device *dev, enum sensor_channel chan)
+{
+    struct max30102_data *data = dev->data;
+    const uint8_t *buffer = data->fifo_buf;
+    int num_samples;
+    int fifo_chan;
+    int sample;
+
+    if (chan == SENSOR_CHAN_DIE_TEMP)
+    {
+        return max30102_die_temp_fetch(dev);
+    }
+
+    num_samples = max30102_fifo_drain(dev, data->fifo_buf, MAX30102_FIFO_DEPTH, NULL);
+    if (num_samples < 0)
+    {
+        return num_samples;
+    }
+
+    data->num_samples = num_samples;
+    if (num_samples == 0)
+    {
+        return 0;
+    }
+
+    for (sample = 0; sample < num_samples; sample++)
+    {
+        for (fifo_chan = 0; fifo_chan < data->num_channels; fifo_chan++)
+        {
+            /* Save the raw data */
+            data->fifo[sample][fifo_chan] = max30102_fifo_word(buffer);
+            buffer += MAX30102_BYTES_PER_CHANNEL;
+        }
+    }
+
+    /* Keep the most recent sample for the single value channels */
+    memcpy(data->raw, data->fifo[num_samples - 1], sizeof(data->raw));
+
     return 0;
 }
 
@@ -47,14 +321,33 @@ static int max30102_channel_get(const struct device *dev, enum sensor_channel ch
 {
     struct max30102_data *data = dev->data;
     enum max30102_led_channel led_chan;
+    bool whole_fifo = false;
     int fifo_chan;
+    int i;
 
-    switch (chan)
+    switch ((int)chan)
     {
+    case SENSOR_CHAN_MAX30102_FIFO_COUNT:
+        val->val1 = data->num_samples;
+        val->val2 = 0;
+        return 0;
+
+    case SENSOR_CHAN_DIE_TEMP:
+        /* 1/16 degC steps, both parts carry the sign */
+        val->val1 = data->die_temp / 16;
+        val->val2 = (data->die_temp % 16) * 62500;
+        return 0;
+
+    case SENSOR_CHAN_MAX30102_RED_FIFO:
+        whole_fifo = true;
+        /* fallthrough */
     case SENSOR_CHAN_RED:
         led_chan = MAX30102_LED_CHANNEL_RED;
         break;
 
+    case SENSOR_CHAN_MAX30102_IR_FIFO:
+        whole_fifo = true;
+        /* fallthrough */
     case SENSOR_CHAN_IR:
         led_chan = MAX30102_LED_CHANNEL_IR;
         break;
@@ -75,6 +368,17 @@ static int max30102_channel_get(const struct device *dev, enum sensor_channel ch
         return -ENOTSUP;
     }
 
+    if (whole_fifo)
+    {
+        for (i = 0; i < data->num_samples; i++)
+        {
+            val[i].val1 = data->fifo[i][fifo_chan];
+            val[i].val2 = 0;
+        }
+
+        return 0;
+    }
+
     /* TODO: Scale the raw data to standard units */
     val->val1 = data->raw[fifo_chan];
     val->val2 = 0;
@@ -82,53 +386,211 @@ static int max30102_channel_get(const struct device *dev, enum sensor_channel ch
     return 0;
 }
 
-static int max30102_attr_set(const struct device *dev, enum sensor_channel chan, enum sensor_attribute attr, const struct sensor_value *val)
+/* Longest pulse width per sample rate in SpO2 mode, from 50 to 3200 Hz */
+static const uint8_t max30102_pw_max[8] =
+{
+    MAX30102_PW_18BITS, MAX30102_PW_18BITS, MAX30102_PW_18BITS, MAX30102_PW_18BITS,
+    MAX30102_PW_17BITS, MAX30102_PW_17BITS, MAX30102_PW_16BITS, MAX30102_PW_15BITS,
+};
+
+static int max30102_attr_set(const struct device *dev, enum sensor_channel chan, enum sensor_attribute attr,
+    const struct sensor_value *val)
 {
     const struct max30102_config *config = dev->config;
-    uint8_t led1_pa = 0x00;
-    uint8_t led2_pa = 0x00;
+    struct max30102_data *data = dev->data;
+    uint8_t spo2 = data->spo2;
+    uint8_t sr = (spo2 & MAX30102_SPO2_SR_MASK) >> MAX30102_SPO2_SR_SHIFT;
+    enum max30102_led_channel led_chan;
 
-    if ((chan != SENSOR_CHAN_RED) && (chan != SENSOR_CHAN_IR))
+    switch ((int)attr)
     {
-        LOG_ERR("Not supported channel");
-        return -ENOTSUP;
-    }
+    case SENSOR_ATTR_MAX30102_LED_PA:
+        if (chan == SENSOR_CHAN_RED)
+        {
+            led_chan = MAX30102_LED_CHANNEL_RED;
+        }
+        else if (chan == SENSOR_CHAN_IR)
+        {
+            led_chan = MAX30102_LED_CHANNEL_IR;
+        }
+        else
+        {
+            LOG_ERR("Not supported channel");
+            return -ENOTSUP;
+        }
 
-    switch (val->val1)
-    {
-    case MAX30102_POWER_ON:
-        led1_pa = CONFIG_MAX30102_LED1_PA;
-        led2_pa = CONFIG_MAX30102_LED2_PA;
+        if ((val->val1 < 0) || (val->val1 > UINT8_MAX))
+        {
+            return -EINVAL;
+        }
+
+        if (i2c_reg_write_byte_dt(&config->i2c, MAX30102_REG_LED1_PA + led_chan, val->val1))
+        {
+            return -EIO;
+        }
+        data->led_pa[led_chan] = val->val1;
+        return 0;
+
+    case SENSOR_ATTR_MAX30102_ADC_RANGE:
+        if ((val->val1 < 0) || (val->val1 > MAX30102_SPO2_ADC_RGE_MAX))
+        {
+            return -EINVAL;
+        }
+        spo2 = (spo2 & ~MAX30102_SPO2_ADC_RGE_MASK) | (val->val1 << MAX30102_SPO2_ADC_RGE_SHIFT);
         break;
 
-    case MAX30102_POWER_OFF:
-        led1_pa = 0x00;
-        led2_pa = 0x00;
+    case SENSOR_ATTR_MAX30102_PULSE_WIDTH:
+        if ((val->val1 < MAX30102_PW_15BITS) || (val->val1 > max30102_pw_max[sr]))
+        {
+            return -EINVAL;
+        }
+        spo2 = (spo2 & ~MAX30102_SPO2_PW_MASK) | (val->val1 << MAX30102_SPO2_PW_SHIFT);
         break;
 
     default:
-        break;
+        return -ENOTSUP;
     }
 
-    if (i2c_reg_write_byte_dt(&config->i2c, MAX30102_REG_LED1_PA, led1_pa))
+    if (i2c_reg_write_byte_dt(&config->i2c, MAX30102_REG_SPO2_CFG, spo2))
     {
         return -EIO;
     }
-    if (i2c_reg_write_byte_dt(&config->i2c, MAX30102_REG_LED2_PA, led2_pa))
+    data->spo2 = spo2;
+
+    return 0;
+}
+
+static int max30102_attr_get(const struct device *dev, enum sensor_channel chan, enum sensor_attribute attr,
+    struct sensor_value *val)
+{
+    struct max30102_data *data = dev->data;
+
+    switch ((int)attr)
     {
-        return -EIO;
+    case SENSOR_ATTR_MAX30102_LED_PA:
+        if ((chan != SENSOR_CHAN_RED) && (chan != SENSOR_CHAN_IR))
+        {
+            LOG_ERR("Not supported channel");
+            return -ENOTSUP;
+        }
+        val->val1 = data->led_pa[(chan == SENSOR_CHAN_RED) ? MAX30102_LED_CHANNEL_RED : MAX30102_LED_CHANNEL_IR];
+        break;
+
+    case SENSOR_ATTR_MAX30102_ADC_RANGE:
+        val->val1 = (data->spo2 & MAX30102_SPO2_ADC_RGE_MASK) >> MAX30102_SPO2_ADC_RGE_SHIFT;
+        break;
+
+    case SENSOR_ATTR_MAX30102_PULSE_WIDTH:
+        val->val1 = (data->spo2 & MAX30102_SPO2_PW_MASK) >> MAX30102_SPO2_PW_SHIFT;
+        break;
+
+    default:
+        return -ENOTSUP;
     }
 
+    val->val2 = 0;
+
     return 0;
 }
 
 static const struct sensor_driver_api max30102_driver_api =
 {
     .attr_set = max30102_attr_set,
+    .attr_get = max30102_attr_get,
+#ifdef CONFIG_MAX30102_TRIGGER
+    .trigger_set = max30102_trigger_set,
+#endif
     .sample_fetch = max30102_sample_fetch,
     .channel_get = max30102_channel_get,
+#ifdef CONFIG_SENSOR_ASYNC_API
+    .submit = max30102_submit,
+    .get_decoder = max30102_get_decoder,
+#endif
 };
 
+/* Write the FIFO, SpO2, LED and slot configuration, the mode is left to the caller */
+static int max30102_configure(const struct device *dev)
+{
+    const struct max30102_config *config = dev->config;
+    struct max30102_data *data = dev->data;
+
+    /* Write the FIFO configuration register */
+    if (i2c_reg_write_byte_dt(&config->i2c, MAX30102_REG_FIFO_CFG, config->fifo))
+    {
+        return -EIO;
+    }
+
+    /* Write the SpO2 configuration register */
+    if (i2c_reg_write_byte_dt(&config->i2c, MAX30102_REG_SPO2_CFG, data->spo2))
+    {
+        return -EIO;
+    }
+
+    /* Write the LED pulse amplitude registers */
+    if (i2c_reg_write_byte_dt(&config->i2c, MAX30102_REG_LED1_PA, data->led_pa[0]))
+    {
+        return -EIO;
+    }
+    if (i2c_reg_write_byte_dt(&config->i2c, MAX30102_REG_LED2_PA, data->led_pa[1]))
+    {
+        return -EIO;
+    }
+    /* There is no third LED on the MAX30102, keep its driver off */
+    if (i2c_reg_write_byte_dt(&config->i2c, MAX30102_REG_LED3_PA, 0))
+    {
+        return -EIO;
+    }
+
+#ifdef CONFIG_MAX30102_MULTI_LED_MODE
+    uint8_t multi_led[2];
+
+    /* Write the multi-LED mode control registers */
+    multi_led[0] = (config->slot[1] << 4) | (config->slot[0]);
+    multi_led[1] = (config->slot[3] << 4) | (config->slot[2]);
+
+    if (i2c_reg_write_byte_dt(&config->i2c, MAX30102_REG_MULTI_LED, multi_led[0]))
+    {
+        return -EIO;
+    }
+    if (i2c_reg_write_byte_dt(&config->i2c, MAX30102_REG_MULTI_LED + 1, multi_led[1]))
+    {
+        return -EIO;
+    }
+#endif
+
+    return 0;
+}
+
+/*
+ * The shutdown stops the LEDs and the ADC, the registers are retained
+ * over I2C. The configuration, including the attributes set at runtime,
+ * is still written again on resume, in case the supply was cut, and the
+ * FIFO is flushed so that the first samples read are taken after the
+ * resume.
+ */
+static int max30102_pm_action(const struct device *dev, enum pm_device_action action)
+{
+    const struct max30102_config *config = dev->config;
+
+    switch (action)
+    {
+    case PM_DEVICE_ACTION_RESUME:
+        if (max30102_configure(dev) || max30102_fifo_flush(dev))
+        {
+            return -EIO;
+        }
+
+        return i2c_reg_write_byte_dt(&config->i2c, MAX30102_REG_MODE_CFG, config->mode) ? -EIO : 0;
+
+    case PM_DEVICE_ACTION_SUSPEND:
+        return i2c_reg_write_byte_dt(&config->i2c, MAX30102_REG_MODE_CFG,
+            config->mode | MAX30102_MODE_CFG_SHDN_MASK) ? -EIO : 0;
+
+    default:
+        return -ENOTSUP;
+    }
+}
+
 static int max30102_init(const struct device *dev)
 {
     const struct max30102_config *config = dev->config;
@@ -143,6 +605,13 @@ static int max30102_init(const struct device *dev)
         return -ENODEV;
     }
 
+    data->dev = dev;
+    data->work_q = &k_sys_work_q;
+    k_work_init_delayable(&data->die_temp_work, max30102_die_temp_work_cb);
+#ifdef CONFIG_SENSOR_ASYNC_API
+    k_work_init(&data->submit_work, max30102_submit_work_cb);
+#endif
+
     /* Check the part id to make sure this is MAX30102 */
     if (i2c_reg_read_byte_dt(&config->i2c, MAX30102_REG_PART_ID, &part_id))
     {
@@ -184,54 +653,19 @@ static int max30102_init(const struct device *dev)
         }
     } while (mode_cfg & MAX30102_MODE_CFG_RESET_MASK);
 
-    /* Write the FIFO configuration register */
-    if (i2c_reg_write_byte_dt(&config->i2c, MAX30102_REG_FIFO_CFG, config->fifo))
-    {
-        return -EIO;
-    }
-
-    /* Write the mode configuration register */
-    if (i2c_reg_write_byte_dt(&config->i2c, MAX30102_REG_MODE_CFG, config->mode))
-    {
-        return -EIO;
-    }
-
-    /* Write the SpO2 configuration register */
-    if (i2c_reg_write_byte_dt(&config->i2c, MAX30102_REG_SPO2_CFG, config->spo2))
-    {
-        return -EIO;
-    }
+    data->spo2 = config->spo2;
+    memcpy(data->led_pa, config->led_pa, sizeof(data->led_pa));
 
-    /* Write the LED pulse amplitude registers */
-    if (i2c_reg_write_byte_dt(&config->i2c, MAX30102_REG_LED1_PA, config->led_pa[0]))
-    {
-        return -EIO;
-    }
-    if (i2c_reg_write_byte_dt(&config->i2c, MAX30102_REG_LED2_PA, config->led_pa[1]))
+    if (max30102_configure(dev))
     {
         return -EIO;
     }
-    if (i2c_reg_write_byte_dt(&config->i2c, MAX30102_REG_LED3_PA, config->led_pa[2]))
-    {
-        return -EIO;
-    }
-
-#ifdef CONFIG_MAX30102_MULTI_LED_MODE
-    uint8_t multi_led[2];
-
-    /* Write the multi-LED mode control registers */
-    multi_led[0] = (config->slot[1] << 4) | (config->slot[0]);
-    multi_led[1] = (config->slot[3] << 4) | (config->slot[2]);
 
-    if (i2c_reg_write_byte_dt(&config->i2c, MAX30102_REG_MULTI_LED, multi_led[0]))
-    {
-        return -EIO;
-    }
-    if (i2c_reg_write_byte_dt(&config->i2c, MAX30102_REG_MULTI_LED + 1, multi_led[1]))
+    /* Stay in shutdown until the first user resumes the sensor */
+    if (i2c_reg_write_byte_dt(&config->i2c, MAX30102_REG_MODE_CFG, config->mode | MAX30102_MODE_CFG_SHDN_MASK))
     {
         return -EIO;
     }
-#endif
 
     /* Initialize the channel map and active channel count */
     data->num_channels = 0U;
@@ -253,12 +687,25 @@ static int max30102_init(const struct device *dev)
         }
     }
 
-    return 0;
+#ifdef CONFIG_MAX30102_TRIGGER
+    if (max30102_init_interrupt(dev))
+    {
+        LOG_ERR("Could not initialize interrupts");
+        return -EIO;
+    }
+#endif
+
+    pm_device_init_suspended(dev);
+
+    return pm_device_runtime_enable(dev);
 }
 
 static struct max30102_config max30102_config =
 {
     .i2c = I2C_DT_SPEC_INST_GET(0),
+#ifdef CONFIG_MAX30102_TRIGGER
+    .int_gpio = GPIO_DT_SPEC_INST_GET_OR(0, int_gpios, {0}),
+#endif
     .fifo = (CONFIG_MAX30102_SMP_AVE << MAX30102_FIFO_CFG_SMP_AVE_SHIFT) |
 #ifdef CONFIG_MAX30102_FIFO_ROLLOVER_EN
     MAX30102_FIFO_CFG_ROLLOVER_EN_MASK |
@@ -289,11 +736,13 @@ static struct max30102_config max30102_config =
         (CONFIG_MAX30102_SR << MAX30102_SPO2_SR_SHIFT) |
         (MAX30102_PW_18BITS << MAX30102_SPO2_PW_SHIFT),
 
-    .led_pa[0] = 0x00,
-    .led_pa[1] = 0x00,
+    .led_pa[0] = CONFIG_MAX30102_LED1_PA,
+    .led_pa[1] = CONFIG_MAX30102_LED2_PA,
 };
 
 static struct max30102_data max30102_data;
 
-SENSOR_DEVICE_DT_INST_DEFINE(0, max30102_init, NULL, &max30102_data, &max30102_config,
+PM_DEVICE_DT_INST_DEFINE(0, max30102_pm_action);
+
+SENSOR_DEVICE_DT_INST_DEFINE(0, max30102_init, PM_DEVICE_DT_INST_GET(0), &max30102_data, &max30102_config,
     POST_KERNEL, CONFIG_SENSOR_INIT_PRIORITY, &max30102_driver_api);
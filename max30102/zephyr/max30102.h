@@ -2,6 +2,9 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#ifndef MAX30102_H
+#define MAX30102_H
+
 #include <zephyr/drivers/sensor.h>
 #include <zephyr/drivers/i2c.h>
 #include <zephyr/drivers/gpio.h>
@@ -29,7 +32,10 @@
 #define MAX30102_REG_REV_ID         0xfe
 #define MAX30102_REG_PART_ID        0xff
 
+#define MAX30102_INT_A_FULL_MASK    (1 << 7)
 #define MAX30102_INT_PPG_MASK       (1 << 6)
+#define MAX30102_INT_PWR_RDY_MASK   (1 << 0)
+#define MAX30102_INT_DIE_TEMP_MASK  (1 << 1)
 
 #define MAX30102_FIFO_CFG_SMP_AVE_SHIFT       5
 #define MAX30102_FIFO_CFG_FIFO_FULL_SHIFT     0
@@ -38,9 +44,15 @@
 #define MAX30102_MODE_CFG_SHDN_MASK     (1 << 7)
 #define MAX30102_MODE_CFG_RESET_MASK    (1 << 6)
 
+#define MAX30102_TEMP_CFG_TEMP_EN_MASK    (1 << 0)
+
 #define MAX30102_SPO2_ADC_RGE_SHIFT    5
 #define MAX30102_SPO2_SR_SHIFT         2
 #define MAX30102_SPO2_PW_SHIFT         0
+#define MAX30102_SPO2_ADC_RGE_MASK     (0x03 << MAX30102_SPO2_ADC_RGE_SHIFT)
+#define MAX30102_SPO2_SR_MASK          (0x07 << MAX30102_SPO2_SR_SHIFT)
+#define MAX30102_SPO2_PW_MASK          (0x03 << MAX30102_SPO2_PW_SHIFT)
+#define MAX30102_SPO2_ADC_RGE_MAX      3
 
 #define MAX30102_PART_ID    0x15
 
@@ -48,8 +60,16 @@
 #define MAX30102_MAX_NUM_CHANNELS        2
 #define MAX30102_MAX_BYTES_PER_SAMPLE    (MAX30102_MAX_NUM_CHANNELS * MAX30102_BYTES_PER_CHANNEL)
 
+#define MAX30102_FIFO_DEPTH       32
+#define MAX30102_FIFO_PTR_MASK    (MAX30102_FIFO_DEPTH - 1)
+
 #define MAX30102_SLOT_LED_MASK    0x03
 
+/* Typical conversion time from the datasheet */
+#define MAX30102_DIE_TEMP_CONV_MS             29
+#define MAX30102_DIE_TEMP_POLL_MS             10
+#define MAX30102_DIE_TEMP_READOUT_ATTEMPTS    10
+
 #define MAX30102_FIFO_DATA_BITS    18
 #define MAX30102_FIFO_DATA_MASK    ((1 << MAX30102_FIFO_DATA_BITS) - 1)
 
@@ -81,9 +101,39 @@ enum max30102_pw
     MAX30102_PW_18BITS,
 };
 
+/* Driver specific channels giving access to the samples drained from the
+ * FIFO by the last sample fetch. The RED and IR FIFO channels fill one
+ * sensor_value per sample, so the caller must provide an array of at least
+ * MAX30102_FIFO_DEPTH elements.
+ */
+enum max30102_sensor_channel
+{
+    SENSOR_CHAN_MAX30102_FIFO_COUNT = SENSOR_CHAN_PRIV_START,
+    SENSOR_CHAN_MAX30102_RED_FIFO,
+    SENSOR_CHAN_MAX30102_IR_FIFO,
+};
+
+/*
+ * Driver specific attributes, adjustable while sampling and kept over a
+ * suspend. The LED pulse amplitude is the raw register value, 0.2 mA per
+ * step, of SENSOR_CHAN_RED or SENSOR_CHAN_IR. The ADC range is the raw
+ * ADC_RGE field, from 2048 nA (0) to 16384 nA (3) full scale, and the
+ * pulse width an enum max30102_pw, both common to all the channels. A
+ * pulse width too long for the sample rate is rejected with -EINVAL.
+ */
+enum max30102_sensor_attribute
+{
+    SENSOR_ATTR_MAX30102_LED_PA = SENSOR_ATTR_PRIV_START,
+    SENSOR_ATTR_MAX30102_ADC_RANGE,
+    SENSOR_ATTR_MAX30102_PULSE_WIDTH,
+};
+
 struct max30102_config
 {
     struct i2c_dt_spec i2c;
+#ifdef CONFIG_MAX30102_TRIGGER
+    struct gpio_dt_spec int_gpio;
+#endif
     uint8_t fifo;
     uint8_t spo2;
     uint8_t led_pa[MAX30102_MAX_NUM_CHANNELS];
@@ -91,15 +141,117 @@ struct max30102_config
     enum max30102_slot slot[4];
 };
 
+typedef void (*max30102_die_temp_cb_t)(const struct device *dev, int err, void *user_data);
+
 struct max30102_data
 {
     uint32_t raw[MAX30102_MAX_NUM_CHANNELS];
+    uint32_t fifo[MAX30102_FIFO_DEPTH][MAX30102_MAX_NUM_CHANNELS];
+    uint8_t fifo_buf[MAX30102_FIFO_DEPTH * MAX30102_MAX_BYTES_PER_SAMPLE];
+    /* Die temperature in 1/16 degC */
+    int16_t die_temp;
+    uint8_t num_samples;
     uint8_t map[MAX30102_MAX_NUM_CHANNELS];
     uint8_t num_channels;
+    /* SpO2 configuration and LED pulse amplitudes restored on resume */
+    uint8_t spo2;
+    uint8_t led_pa[MAX30102_MAX_NUM_CHANNELS];
+    const struct device *dev;
+    /* Queue of the die temperature polling and of the asynchronous reads */
+    struct k_work_q *work_q;
+    struct k_work_delayable die_temp_work;
+    max30102_die_temp_cb_t die_temp_cb;
+    void *die_temp_user_data;
+    uint8_t die_temp_attempts;
+#ifdef CONFIG_SENSOR_ASYNC_API
+    /* Pending asynchronous read, drained from work_q */
+    struct k_work submit_work;
+    struct rtio_iodev_sqe *iodev_sqe;
+#endif
+#ifdef CONFIG_MAX30102_TRIGGER
+    struct gpio_callback gpio_cb;
+    sensor_trigger_handler_t wm_handler;
+    const struct sensor_trigger *wm_trigger;
+#if defined(CONFIG_MAX30102_TRIGGER_OWN_THREAD)
+    K_KERNEL_STACK_MEMBER(thread_stack, CONFIG_MAX30102_THREAD_STACK_SIZE);
+    struct k_thread thread;
+    struct k_sem gpio_sem;
+#elif defined(CONFIG_MAX30102_TRIGGER_GLOBAL_THREAD)
+    struct k_work work;
+#endif
+#endif /* CONFIG_MAX30102_TRIGGER */
 };
 
-enum max30102_power_mode
+/* Frame produced by the asynchronous read API. The FIFO bytes are read
+ * straight into the RTIO buffer and only unpacked by the decoder.
+ */
+struct max30102_encoded_data
 {
-    MAX30102_POWER_OFF = 0,
-    MAX30102_POWER_ON,
+    uint64_t timestamp;
+    uint32_t sample_period_ns;
+    uint8_t num_samples;
+    uint8_t num_channels;
+    uint8_t map[MAX30102_MAX_NUM_CHANNELS];
+    uint8_t fifo[];
 };
+
+/* Unpack one 18-bit channel word from the FIFO data byte stream */
+static inline uint32_t max30102_fifo_word(const uint8_t *buffer)
+{
+    return ((buffer[0] << 16) | (buffer[1] << 8) | buffer[2]) & MAX30102_FIFO_DATA_MASK;
+}
+
+/*
+ * Unpack num_samples samples of num_channels words each from the FIFO data
+ * byte stream, FIFO channel n going to dest[n]. A NULL array is skipped.
+ */
+void max30102_fifo_unpack(const uint8_t *buffer, uint8_t num_channels, uint32_t *const *dest, int num_samples);
+
+/*
+ * Drain up to max_samples samples from the FIFO straight into the caller
+ * arrays, without going through sensor_value. The array of an inactive led
+ * channel, or a NULL array, is skipped. The FIFO overflow counter, i.e. the
+ * number of samples lost before this read, is stored in overflow when it is
+ * not NULL.
+ *
+ * Returns the number of samples read or a negative error code.
+ */
+int max30102_fifo_read(const struct device *dev, uint32_t *red, uint32_t *ir, uint16_t max_samples,
+    uint8_t *overflow);
+
+int max30102_fifo_drain(const struct device *dev, uint8_t *buffer, uint16_t max_samples, uint8_t *overflow);
+
+/* Reset the FIFO write, overflow and read pointers, dropping the pending samples */
+int max30102_fifo_flush(const struct device *dev);
+
+/*
+ * Start a die temperature conversion without blocking. TEMP_EN is polled
+ * from a delayable work item and cb is called once the temperature can
+ * be read with sensor_channel_get() or the conversion failed. Returns
+ * -EBUSY while another conversion is pending.
+ */
+int max30102_die_temp_start(const struct device *dev, max30102_die_temp_cb_t cb, void *user_data);
+
+/*
+ * Run the die temperature polling and its callback, as well as the FIFO
+ * drain of the asynchronous reads, on queue instead of the system work
+ * queue. Only call it while no conversion or read is pending.
+ */
+void max30102_work_queue_set(const struct device *dev, struct k_work_q *queue);
+
+#ifdef CONFIG_SENSOR_ASYNC_API
+void max30102_submit(const struct device *dev, struct rtio_iodev_sqe *iodev_sqe);
+
+void max30102_submit_work_cb(struct k_work *work);
+
+int max30102_get_decoder(const struct device *dev, const struct sensor_decoder_api **decoder);
+#endif
+
+#ifdef CONFIG_MAX30102_TRIGGER
+int max30102_trigger_set(const struct device *dev, const struct sensor_trigger *trig,
+    sensor_trigger_handler_t handler);
+
+int max30102_init_interrupt(const struct device *dev);
+#endif
+
+#endif /* MAX30102_H */
@@ -0,0 +1,112 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define DT_DRV_COMPAT maxim_max30102
+
+#include <string.h>
+
+#include <zephyr/rtio/rtio.h>
+
+#include "zephyr/logging/log.h"
+
+#include "max30102.h"
+
+LOG_MODULE_DECLARE(MAX30102, CONFIG_SENSOR_LOG_LEVEL);
+
+/* Effective sample rates selected by CONFIG_MAX30102_SR */
+static const uint16_t max30102_sample_rate_hz[] = {50, 100, 200, 400, 800, 1000, 1600, 3200};
+
+static uint32_t max30102_sample_period_ns(void)
+{
+    /* Sample averaging decimates by up to 32 */
+    return (NSEC_PER_SEC / max30102_sample_rate_hz[CONFIG_MAX30102_SR]) << MIN(CONFIG_MAX30102_SMP_AVE, 5);
+}
+
+static void max30102_submit_complete(struct max30102_data *data, int err)
+{
+    struct rtio_iodev_sqe *iodev_sqe = data->iodev_sqe;
+
+    /* Cleared first, the completion may already submit the next read */
+    data->iodev_sqe = NULL;
+
+    if (err)
+    {
+        rtio_iodev_sqe_err(iodev_sqe, err);
+    }
+    else
+    {
+        rtio_iodev_sqe_ok(iodev_sqe, 0);
+    }
+}
+
+/*
+ * Drain the FIFO for the pending read. Runs on the driver work queue, see
+ * max30102_work_queue_set(), so that the I2C transfers never block the
+ * submitter.
+ */
+void max30102_submit_work_cb(struct k_work *work)
+{
+    struct max30102_data *data = CONTAINER_OF(work, struct max30102_data, submit_work);
+    struct max30102_encoded_data *edata;
+    uint32_t sample_size = data->num_channels * MAX30102_BYTES_PER_CHANNEL;
+    uint32_t min_buf_len = sizeof(struct max30102_encoded_data) + sample_size;
+    uint32_t max_buf_len = sizeof(struct max30102_encoded_data) + (MAX30102_FIFO_DEPTH * sample_size);
+    uint8_t *buf;
+    uint32_t buf_len;
+    int num_samples;
+    int rc;
+
+    rc = rtio_sqe_rx_buf(data->iodev_sqe, min_buf_len, max_buf_len, &buf, &buf_len);
+    if (rc != 0)
+    {
+        LOG_ERR("Failed to get a read buffer of size %u bytes", min_buf_len);
+        max30102_submit_complete(data, rc);
+        return;
+    }
+
+    edata = (struct max30102_encoded_data *)buf;
+
+    /* The FIFO is drained straight into the RTIO buffer */
+    num_samples = max30102_fifo_drain(data->dev, edata->fifo, (buf_len - sizeof(*edata)) / sample_size, NULL);
+    if (num_samples < 0)
+    {
+        max30102_submit_complete(data, num_samples);
+        return;
+    }
+
+    edata->timestamp = k_ticks_to_ns_floor64(k_uptime_ticks());
+    edata->sample_period_ns = max30102_sample_period_ns();
+    edata->num_samples = num_samples;
+    edata->num_channels = data->num_channels;
+    memcpy(edata->map, data->map, sizeof(edata->map));
+
+    max30102_submit_complete(data, 0);
+}
+
+void max30102_submit(const struct device *dev, struct rtio_iodev_sqe *iodev_sqe)
+{
+    const struct sensor_read_config *cfg = iodev_sqe->sqe.iodev->data;
+    struct max30102_data *data = dev->data;
+
+    for (size_t i = 0; i < cfg->count; i++)
+    {
+        if ((cfg->channels[i].chan_type != SENSOR_CHAN_RED) &&
+            (cfg->channels[i].chan_type != SENSOR_CHAN_IR) &&
+            (cfg->channels[i].chan_type != SENSOR_CHAN_ALL))
+        {
+            LOG_ERR("Unsupported sensor channel");
+            rtio_iodev_sqe_err(iodev_sqe, -ENOTSUP);
+            return;
+        }
+    }
+
+    if (data->iodev_sqe != NULL)
+    {
+        rtio_iodev_sqe_err(iodev_sqe, -EBUSY);
+        return;
+    }
+
+    data->iodev_sqe = iodev_sqe;
+    k_work_submit_to_queue(data->work_q, &data->submit_work);
+}
@@ -0,0 +1,121 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define DT_DRV_COMPAT maxim_max30102
+
+#include "max30102.h"
+
+/* Raw samples are 18-bit counts, so a shift of 18 keeps them exact in q31 */
+#define MAX30102_Q31_SHIFT    MAX30102_FIFO_DATA_BITS
+
+static int max30102_decoder_fifo_chan(const struct max30102_encoded_data *edata, struct sensor_chan_spec chan_spec)
+{
+    enum max30102_led_channel led_chan;
+
+    switch (chan_spec.chan_type)
+    {
+    case SENSOR_CHAN_RED:
+        led_chan = MAX30102_LED_CHANNEL_RED;
+        break;
+
+    case SENSOR_CHAN_IR:
+        led_chan = MAX30102_LED_CHANNEL_IR;
+        break;
+
+    default:
+        return -ENOTSUP;
+    }
+
+    if ((chan_spec.chan_idx != 0) || (edata->map[led_chan] >= MAX30102_MAX_NUM_CHANNELS))
+    {
+        return -ENOTSUP;
+    }
+
+    return edata->map[led_chan];
+}
+
+static int max30102_decoder_get_frame_count(const uint8_t *buffer, struct sensor_chan_spec chan_spec,
+    uint16_t *frame_count)
+{
+    const struct max30102_encoded_data *edata = (const struct max30102_encoded_data *)buffer;
+
+    if (max30102_decoder_fifo_chan(edata, chan_spec) < 0)
+    {
+        return -ENOTSUP;
+    }
+
+    *frame_count = edata->num_samples;
+
+    return 0;
+}
+
+static int max30102_decoder_get_size_info(struct sensor_chan_spec chan_spec, size_t *base_size, size_t *frame_size)
+{
+    switch (chan_spec.chan_type)
+    {
+    case SENSOR_CHAN_RED:
+    case SENSOR_CHAN_IR:
+        *base_size = sizeof(struct sensor_q31_data);
+        *frame_size = sizeof(struct sensor_q31_sample_data);
+        return 0;
+
+    default:
+        return -ENOTSUP;
+    }
+}
+
+static int max30102_decoder_decode(const uint8_t *buffer, struct sensor_chan_spec chan_spec, uint32_t *fit,
+    uint16_t max_count, void *data_out)
+{
+    const struct max30102_encoded_data *edata = (const struct max30102_encoded_data *)buffer;
+    struct sensor_q31_data *out = data_out;
+    size_t sample_size = edata->num_channels * MAX30102_BYTES_PER_CHANNEL;
+    const uint8_t *fifo;
+    int fifo_chan;
+    uint16_t count;
+
+    fifo_chan = max30102_decoder_fifo_chan(edata, chan_spec);
+    if (fifo_chan < 0)
+    {
+        return fifo_chan;
+    }
+
+    if (*fit >= edata->num_samples)
+    {
+        return 0;
+    }
+
+    /* The frame timestamp is taken when the newest sample was drained */
+    out->header.base_timestamp_ns = edata->timestamp -
+        ((uint64_t)(edata->num_samples - 1) * edata->sample_period_ns);
+    out->shift = MAX30102_Q31_SHIFT;
+
+    fifo = &edata->fifo[(*fit * sample_size) + (fifo_chan * MAX30102_BYTES_PER_CHANNEL)];
+    for (count = 0; (count < max_count) && (*fit < edata->num_samples); count++, (*fit)++)
+    {
+        out->readings[count].timestamp_delta = *fit * edata->sample_period_ns;
+        out->readings[count].value = (q31_t)(max30102_fifo_word(fifo) << (31 - MAX30102_Q31_SHIFT));
+        fifo += sample_size;
+    }
+
+    out->header.reading_count = count;
+
+    return count;
+}
+
+SENSOR_DECODER_API_DT_DEFINE() =
+{
+    .get_frame_count = max30102_decoder_get_frame_count,
+    .get_size_info = max30102_decoder_get_size_info,
+    .decode = max30102_decoder_decode,
+};
+
+int max30102_get_decoder(const struct device *dev, const struct sensor_decoder_api **decoder)
+{
+    ARG_UNUSED(dev);
+
+    *decoder = &SENSOR_DECODER_NAME();
+
+    return 0;
+}
@@ -0,0 +1,502 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define DT_DRV_COMPAT maxim_max30102
+
+#include <math.h>
+#include <string.h>
+
+#include <zephyr/device.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/drivers/i2c.h>
+#include <zephyr/drivers/i2c_emul.h>
+#include <zephyr/drivers/gpio/gpio_emul.h>
+#include <zephyr/sys/util.h>
+
+#include "zephyr/logging/log.h"
+
+#include "max30102.h"
+#include "max30102_emul.h"
+
+LOG_MODULE_REGISTER(max30102_emul, CONFIG_SENSOR_LOG_LEVEL);
+
+#define MAX30102_EMUL_NUM_REGS    256
+#define MAX30102_EMUL_REV_ID      0x03
+
+/* Counts per LED PA step at the 31.25 pA/LSB range and 411 us pulse width */
+#define MAX30102_EMUL_COUNTS_PER_PA    800
+
+#define MAX30102_EMUL_DEFAULT_BPM     72
+#define MAX30102_EMUL_DEFAULT_SPO2    97
+
+/* IR perfusion index in 1/10000 */
+#define MAX30102_EMUL_IR_PERFUSION    200
+
+/* Default die temperature, 30 degC in 1/16 degC */
+#define MAX30102_EMUL_DEFAULT_TEMP    (30 * 16)
+
+struct max30102_emul_cfg
+{
+    struct gpio_dt_spec int_gpio;
+};
+
+struct max30102_emul_data
+{
+    const struct emul *target;
+    struct k_spinlock lock;
+    struct k_timer sample_timer;
+    uint8_t reg[MAX30102_EMUL_NUM_REGS];
+    uint8_t reg_addr;
+    uint32_t fifo[MAX30102_FIFO_DEPTH][MAX30102_MAX_NUM_CHANNELS];
+    uint8_t fifo_count;
+    uint8_t fifo_byte;
+    uint32_t sample_period_us;
+    /* Synthetic signal */
+    uint8_t bpm;
+    uint32_t phase_step;
+    uint32_t phase;
+    uint16_t red_perfusion;
+    uint32_t noise;
+    /* Playback of a recording */
+    const uint32_t *play_red;
+    const uint32_t *play_ir;
+    size_t play_len;
+    size_t play_pos;
+    int16_t die_temp;
+};
+
+/* Effective sample rates selected by the SPO2_CFG SR field */
+static const uint16_t max30102_emul_sample_rate_hz[] = {50, 100, 200, 400, 800, 1000, 1600, 3200};
+
+static void max30102_emul_por(struct max30102_emul_data *data)
+{
+    memset(data->reg, 0, sizeof(data->reg));
+    data->reg[MAX30102_REG_INT_STS1] = MAX30102_INT_PWR_RDY_MASK;
+    data->reg[MAX30102_REG_REV_ID] = MAX30102_EMUL_REV_ID;
+    data->reg[MAX30102_REG_PART_ID] = MAX30102_PART_ID;
+    data->fifo_count = 0;
+    data->fifo_byte = 0;
+}
+
+static uint8_t max30102_emul_num_channels(const struct max30102_emul_data *data)
+{
+    switch (data->reg[MAX30102_REG_MODE_CFG] & 0x07)
+    {
+    case MAX30102_MODE_HEART_RATE:
+        return 1;
+    case MAX30102_MODE_SPO2:
+        return 2;
+    case MAX30102_MODE_MULTI_LED:
+        return ((data->reg[MAX30102_REG_MULTI_LED] & 0x07) != 0) +
+               ((data->reg[MAX30102_REG_MULTI_LED] & 0x70) != 0);
+    default:
+        return 0;
+    }
+}
+
+/* LED driven in the given FIFO channel, 0 for red and 1 for IR */
+static uint8_t max30102_emul_channel_led(const struct max30102_emul_data *data, uint8_t chan)
+{
+    uint8_t slot;
+
+    if ((data->reg[MAX30102_REG_MODE_CFG] & 0x07) != MAX30102_MODE_MULTI_LED)
+    {
+        return chan;
+    }
+
+    slot = (data->reg[MAX30102_REG_MULTI_LED] >> (chan * 4)) & MAX30102_SLOT_LED_MASK;
+
+    return (slot == MAX30102_SLOT_IR_LED2_PA) ? MAX30102_LED_CHANNEL_IR : MAX30102_LED_CHANNEL_RED;
+}
+
+static uint32_t max30102_emul_sample_period_us(const struct max30102_emul_data *data)
+{
+    uint8_t sr = (data->reg[MAX30102_REG_SPO2_CFG] >> MAX30102_SPO2_SR_SHIFT) & 0x07;
+    uint8_t smp_ave = data->reg[MAX30102_REG_FIFO_CFG] >> MAX30102_FIFO_CFG_SMP_AVE_SHIFT;
+
+    return (USEC_PER_SEC / max30102_emul_sample_rate_hz[sr]) << MIN(smp_ave, 5);
+}
+
+/*
+ * Pulse shape in [-1, 1]: a fast systolic upstroke followed by a slower
+ * decay with a dicrotic wave, close enough to a finger PPG for the filters
+ * and the beat detector.
+ */
+static float max30102_emul_pulse(float phase)
+{
+    float x = 2.0f * 3.14159265f * phase;
+
+    return 0.7f * sinf(x) + 0.25f * sinf(2.0f * x + 0.8f) + 0.05f * sinf(3.0f * x);
+}
+
+static uint32_t max30102_emul_synthetic(struct max30102_emul_data *data, uint8_t led, float pulse)
+{
+    uint8_t adc_rge = (data->reg[MAX30102_REG_SPO2_CFG] >> MAX30102_SPO2_ADC_RGE_SHIFT) & 0x03;
+    uint8_t pw = data->reg[MAX30102_REG_SPO2_CFG] & 0x03;
+    uint8_t pa = data->reg[MAX30102_REG_LED1_PA + led];
+    uint16_t perfusion = (led == MAX30102_LED_CHANNEL_RED) ? data->red_perfusion : MAX30102_EMUL_IR_PERFUSION;
+    int32_t dc;
+    int32_t val;
+
+    /* The photodiode charge doubles with every pulse width step and the
+     * LSB size doubles with every range step.
+     */
+    dc = (pa * MAX30102_EMUL_COUNTS_PER_PA * 4) >> (adc_rge + (MAX30102_PW_18BITS - pw));
+
+    /* Small LCG noise around 0.05 % of the DC level */
+    data->noise = data->noise * 1103515245u + 12345u;
+    val = dc + (int32_t)((float)dc * ((float)perfusion / 10000.0f) * pulse / 2.0f);
+    val += ((int32_t)((data->noise >> 16) & 0xff) - 128) * dc / 256000;
+
+    return CLAMP(val, 0, MAX30102_FIFO_DATA_MASK);
+}
+
+static void max30102_emul_sample_push(struct max30102_emul_data *data)
+{
+    uint8_t num_channels = max30102_emul_num_channels(data);
+    uint8_t wr = data->reg[MAX30102_REG_FIFO_WR] & MAX30102_FIFO_PTR_MASK;
+    uint8_t pw = data->reg[MAX30102_REG_SPO2_CFG] & 0x03;
+    float pulse;
+
+    data->phase += data->phase_step;
+    pulse = max30102_emul_pulse((float)data->phase / 4294967296.0f);
+
+    if (data->fifo_count == MAX30102_FIFO_DEPTH)
+    {
+        if (data->reg[MAX30102_REG_FIFO_OVF] < MAX30102_FIFO_PTR_MASK)
+        {
+            data->reg[MAX30102_REG_FIFO_OVF]++;
+        }
+
+        if ((data->reg[MAX30102_REG_FIFO_CFG] & MAX30102_FIFO_CFG_ROLLOVER_EN_MASK) == 0)
+        {
+            return;
+        }
+
+        /* The oldest sample is overwritten */
+        data->reg[MAX30102_REG_FIFO_RD] = (data->reg[MAX30102_REG_FIFO_RD] + 1) & MAX30102_FIFO_PTR_MASK;
+        data->fifo_byte = 0;
+        data->fifo_count--;
+    }
+
+    for (uint8_t chan = 0; chan < num_channels; chan++)
+    {
+        uint8_t led = max30102_emul_channel_led(data, chan);
+        uint32_t val;
+
+        if (data->play_len != 0)
+        {
+            val = (led == MAX30102_LED_CHANNEL_RED) ? data->play_red[data->play_pos] : data->play_ir[data->play_pos];
+        }
+        else
+        {
+            val = max30102_emul_synthetic(data, led, pulse);
+        }
+
+        /* Lower resolutions leave the LSBs cleared, the data stays left-justified */
+        data->fifo[wr][chan] = val & ~BIT_MASK(MAX30102_PW_18BITS - pw);
+    }
+
+    if (data->play_len != 0)
+    {
+        data->play_pos = (data->play_pos + 1) % data->play_len;
+    }
+
+    data->reg[MAX30102_REG_FIFO_WR] = (wr + 1) & MAX30102_FIFO_PTR_MASK;
+    data->fifo_count++;
+
+    data->reg[MAX30102_REG_INT_STS1] |= MAX30102_INT_PPG_MASK;
+    if (data->fifo_count >= (MAX30102_FIFO_DEPTH - (data->reg[MAX30102_REG_FIFO_CFG] & 0x0f)))
+    {
+        data->reg[MAX30102_REG_INT_STS1] |= MAX30102_INT_A_FULL_MASK;
+    }
+}
+
+/* INT is asserted while any enabled status bit is set */
+static bool max30102_emul_int_active(const struct max30102_emul_data *data)
+{
+    return ((data->reg[MAX30102_REG_INT_STS1] & data->reg[MAX30102_REG_INT_EN1]) != 0) ||
+           ((data->reg[MAX30102_REG_INT_STS2] & data->reg[MAX30102_REG_INT_EN2]) != 0);
+}
+
+static void max30102_emul_int_update(const struct emul *target, bool active)
+{
+    const struct max30102_emul_cfg *cfg = target->cfg;
+    gpio_flags_t flags;
+
+    /* The level can only be driven once the driver configured the pin */
+    if ((cfg->int_gpio.port == NULL) ||
+        gpio_emul_flags_get(cfg->int_gpio.port, cfg->int_gpio.pin, &flags) ||
+        ((flags & GPIO_INPUT) == 0))
+    {
+        return;
+    }
+
+    /* The pin is open-drain and active low */
+    gpio_emul_input_set(cfg->int_gpio.port, cfg->int_gpio.pin, active ? 0 : 1);
+}
+
+static void max30102_emul_sample_timer(struct k_timer *timer)
+{
+    struct max30102_emul_data *data = CONTAINER_OF(timer, struct max30102_emul_data, sample_timer);
+    k_spinlock_key_t key = k_spin_lock(&data->lock);
+    bool active;
+
+    max30102_emul_sample_push(data);
+    active = max30102_emul_int_active(data);
+
+    k_spin_unlock(&data->lock, key);
+
+    max30102_emul_int_update(data->target, active);
+}
+
+static void max30102_emul_phase_step_update(struct max30102_emul_data *data)
+{
+    /* Pulse phase advanced by one sample, the phase wraps once per beat */
+    data->phase_step = (uint32_t)(((uint64_t)data->bpm * data->sample_period_us << 32) /
+                                  (60 * USEC_PER_SEC));
+}
+
+/* Start or stop sampling according to the mode and shutdown configuration */
+static void max30102_emul_sampling_update(struct max30102_emul_data *data)
+{
+    uint32_t period_us = max30102_emul_sample_period_us(data);
+    bool running = ((data->reg[MAX30102_REG_MODE_CFG] & MAX30102_MODE_CFG_SHDN_MASK) == 0) &&
+                   (max30102_emul_num_channels(data) != 0);
+
+    if (!running)
+    {
+        k_timer_stop(&data->sample_timer);
+        data->sample_period_us = 0;
+        return;
+    }
+
+    if (period_us != data->sample_period_us)
+    {
+        data->sample_period_us = period_us;
+        max30102_emul_phase_step_update(data);
+        k_timer_start(&data->sample_timer, K_USEC(period_us), K_USEC(period_us));
+    }
+}
+
+static uint8_t max30102_emul_reg_read(struct max30102_emul_data *data)
+{
+    uint8_t addr = data->reg_addr;
+    uint8_t val;
+
+    if (addr != MAX30102_REG_FIFO_DATA)
+    {
+        val = data->reg[addr];
+        data->reg_addr++;
+
+        /* Reading a status register clears it */
+        if ((addr == MAX30102_REG_INT_STS1) || (addr == MAX30102_REG_INT_STS2))
+        {
+            data->reg[addr] = 0;
+        }
+
+        return val;
+    }
+
+    uint8_t num_channels = max30102_emul_num_channels(data);
+    uint8_t rd = data->reg[MAX30102_REG_FIFO_RD] & MAX30102_FIFO_PTR_MASK;
+    uint8_t chan = data->fifo_byte / MAX30102_BYTES_PER_CHANNEL;
+    uint8_t shift = 8 * (MAX30102_BYTES_PER_CHANNEL - 1 - (data->fifo_byte % MAX30102_BYTES_PER_CHANNEL));
+
+    if ((data->fifo_count == 0) || (num_channels == 0))
+    {
+        return 0;
+    }
+
+    /* Reading the FIFO also clears the almost full flag */
+    data->reg[MAX30102_REG_INT_STS1] &= ~MAX30102_INT_A_FULL_MASK;
+
+    val = (uint8_t)(data->fifo[rd][chan] >> shift);
+
+    if (++data->fifo_byte == (num_channels * MAX30102_BYTES_PER_CHANNEL))
+    {
+        data->fifo_byte = 0;
+        data->fifo_count--;
+        data->reg[MAX30102_REG_FIFO_RD] = (rd + 1) & MAX30102_FIFO_PTR_MASK;
+        data->reg[MAX30102_REG_FIFO_OVF] = 0;
+    }
+
+    return val;
+}
+
+static void max30102_emul_reg_write(struct max30102_emul_data *data, uint8_t val)
+{
+    uint8_t addr = data->reg_addr++;
+
+    switch (addr)
+    {
+    case MAX30102_REG_INT_STS1:
+    case MAX30102_REG_INT_STS2:
+    case MAX30102_REG_FIFO_DATA:
+    case MAX30102_REG_TINT:
+    case MAX30102_REG_TFRAC:
+    case MAX30102_REG_REV_ID:
+    case MAX30102_REG_PART_ID:
+        /* Read only */
+        return;
+
+    case MAX30102_REG_MODE_CFG:
+        if (val & MAX30102_MODE_CFG_RESET_MASK)
+        {
+            /* The reset bit clears itself once the POR state is restored */
+            max30102_emul_por(data);
+            break;
+        }
+        data->reg[addr] = val;
+        break;
+
+    case MAX30102_REG_FIFO_WR:
+    case MAX30102_REG_FIFO_OVF:
+    case MAX30102_REG_FIFO_RD:
+        data->reg[addr] = val & MAX30102_FIFO_PTR_MASK;
+        data->fifo_count = (data->reg[MAX30102_REG_FIFO_WR] - data->reg[MAX30102_REG_FIFO_RD]) &
+                           MAX30102_FIFO_PTR_MASK;
+        data->fifo_byte = 0;
+        break;
+
+    case MAX30102_REG_TEMP_CFG:
+        if (val & MAX30102_TEMP_CFG_TEMP_EN_MASK)
+        {
+            /* The conversion is reported as done right away */
+            data->reg[MAX30102_REG_TINT] = (uint8_t)(data->die_temp >> 4);
+            data->reg[MAX30102_REG_TFRAC] = data->die_temp & 0x0f;
+            data->reg[MAX30102_REG_INT_STS2] |= MAX30102_INT_DIE_TEMP_MASK;
+        }
+        data->reg[addr] = 0;
+        break;
+
+    default:
+        data->reg[addr] = val;
+        break;
+    }
+
+    max30102_emul_sampling_update(data);
+}
+
+static int max30102_emul_transfer(const struct emul *target, struct i2c_msg *msgs, int num_msgs, int addr)
+{
+    struct max30102_emul_data *data = target->data;
+    bool addressed = false;
+    k_spinlock_key_t key;
+    bool active;
+
+    key = k_spin_lock(&data->lock);
+
+    for (int i = 0; i < num_msgs; i++)
+    {
+        struct i2c_msg *msg = &msgs[i];
+
+        if (msg->flags & I2C_MSG_READ)
+        {
+            for (uint32_t j = 0; j < msg->len; j++)
+            {
+                msg->buf[j] = max30102_emul_reg_read(data);
+            }
+            addressed = false;
+            continue;
+        }
+
+        for (uint32_t j = 0; j < msg->len; j++)
+        {
+            /* The first byte written after a start selects the register,
+             * a burst write continues into the following message.
+             */
+            if (!addressed)
+            {
+                data->reg_addr = msg->buf[j];
+                addressed = true;
+                continue;
+            }
+
+            max30102_emul_reg_write(data, msg->buf[j]);
+        }
+    }
+
+    active = max30102_emul_int_active(data);
+
+    k_spin_unlock(&data->lock, key);
+
+    max30102_emul_int_update(target, active);
+
+    return 0;
+}
+
+void max30102_emul_synthetic_set(const struct emul *target, uint8_t bpm, uint8_t spo2)
+{
+    struct max30102_emul_data *data = target->data;
+    k_spinlock_key_t key = k_spin_lock(&data->lock);
+
+    data->bpm = bpm;
+    max30102_emul_phase_step_update(data);
+
+    /* Invert the calibration curve SpO2 = 101.72 - 6.4619 * R */
+    data->red_perfusion = (uint16_t)(MAX30102_EMUL_IR_PERFUSION * (101.72f - spo2) / 6.4619f);
+    data->play_len = 0;
+
+    k_spin_unlock(&data->lock, key);
+}
+
+void max30102_emul_playback_set(const struct emul *target, const uint32_t *red, const uint32_t *ir,
+    size_t len)
+{
+    struct max30102_emul_data *data = target->data;
+    k_spinlock_key_t key = k_spin_lock(&data->lock);
+
+    data->play_red = red;
+    data->play_ir = ir;
+    data->play_len = ((red != NULL) && (ir != NULL)) ? len : 0;
+    data->play_pos = 0;
+
+    k_spin_unlock(&data->lock, key);
+}
+
+void max30102_emul_die_temp_set(const struct emul *target, int16_t temp)
+{
+    struct max30102_emul_data *data = target->data;
+    k_spinlock_key_t key = k_spin_lock(&data->lock);
+
+    data->die_temp = temp;
+
+    k_spin_unlock(&data->lock, key);
+}
+
+static int max30102_emul_init(const struct emul *target, const struct device *parent)
+{
+    struct max30102_emul_data *data = target->data;
+
+    ARG_UNUSED(parent);
+
+    data->target = target;
+    data->noise = 1;
+    data->die_temp = MAX30102_EMUL_DEFAULT_TEMP;
+    max30102_emul_por(data);
+    k_timer_init(&data->sample_timer, max30102_emul_sample_timer, NULL);
+    max30102_emul_synthetic_set(target, MAX30102_EMUL_DEFAULT_BPM, MAX30102_EMUL_DEFAULT_SPO2);
+
+    /* INT is released until the driver enables an interrupt */
+    max30102_emul_int_update(target, false);
+
+    return 0;
+}
+
+static const struct i2c_emul_api max30102_emul_api_i2c =
+{
+    .transfer = max30102_emul_transfer,
+};
+
+#define MAX30102_EMUL(n)                                                        \
+    static struct max30102_emul_data max30102_emul_data_##n;                    \
+    static const struct max30102_emul_cfg max30102_emul_cfg_##n =               \
+    {                                                                           \
+        .int_gpio = GPIO_DT_SPEC_INST_GET_OR(n, int_gpios, {0}),                \
+    };                                                                          \
+    EMUL_DT_INST_DEFINE(n, max30102_emul_init, &max30102_emul_data_##n,         \
+        &max30102_emul_cfg_##n, &max30102_emul_api_i2c, NULL)
+
+DT_INST_FOREACH_STATUS_OKAY(MAX30102_EMUL)
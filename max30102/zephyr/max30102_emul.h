@@ -0,0 +1,28 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef MAX30102_EMUL_H
+#define MAX30102_EMUL_H
+
+#include <zephyr/drivers/emul.h>
+
+/*
+ * Generate a synthetic PPG with the given heart rate and SpO2. The pulse
+ * amplitude follows the calibration curve used by the application, so the
+ * computed saturation should match spo2 within the noise.
+ */
+void max30102_emul_synthetic_set(const struct emul *target, uint8_t bpm, uint8_t spo2);
+
+/*
+ * Play back recorded RED and IR samples instead of the synthetic signal.
+ * The recording is looped and must stay valid until playback is stopped
+ * by passing len 0. Samples are 18-bit left-justified FIFO values.
+ */
+void max30102_emul_playback_set(const struct emul *target, const uint32_t *red, const uint32_t *ir,
+    size_t len);
+
+/* Die temperature reported on the next conversion, in 1/16 degC */
+void max30102_emul_die_temp_set(const struct emul *target, int16_t temp);
+
+#endif /* MAX30102_EMUL_H */
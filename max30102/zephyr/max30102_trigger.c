@@ -0,0 +1,173 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define DT_DRV_COMPAT maxim_max30102
+
+#include "zephyr/logging/log.h"
+
+#include "max30102.h"
+
+LOG_MODULE_DECLARE(MAX30102, CONFIG_SENSOR_LOG_LEVEL);
+
+static void max30102_gpio_callback(const struct device *port, struct gpio_callback *cb, uint32_t pins)
+{
+    struct max30102_data *data = CONTAINER_OF(cb, struct max30102_data, gpio_cb);
+
+#if defined(CONFIG_MAX30102_TRIGGER_OWN_THREAD)
+    k_sem_give(&data->gpio_sem);
+#elif defined(CONFIG_MAX30102_TRIGGER_GLOBAL_THREAD)
+    k_work_submit(&data->work);
+#endif
+}
+
+static void max30102_thread_cb(const struct device *dev)
+{
+    struct max30102_data *data = dev->data;
+    const struct max30102_config *config = dev->config;
+    uint8_t int_sts;
+
+    /* Reading the status register deasserts the interrupt pin */
+    if (i2c_reg_read_byte_dt(&config->i2c, MAX30102_REG_INT_STS1, &int_sts))
+    {
+        LOG_ERR("Could not read interrupt status");
+        return;
+    }
+
+    if ((int_sts & MAX30102_INT_A_FULL_MASK) && (data->wm_handler != NULL))
+    {
+        data->wm_handler(dev, data->wm_trigger);
+    }
+}
+
+#if defined(CONFIG_MAX30102_TRIGGER_OWN_THREAD)
+static void max30102_thread(void *p1, void *p2, void *p3)
+{
+    struct max30102_data *data = p1;
+
+    ARG_UNUSED(p2);
+    ARG_UNUSED(p3);
+
+    while (1)
+    {
+        k_sem_take(&data->gpio_sem, K_FOREVER);
+        max30102_thread_cb(data->dev);
+    }
+}
+#elif defined(CONFIG_MAX30102_TRIGGER_GLOBAL_THREAD)
+static void max30102_work_cb(struct k_work *work)
+{
+    struct max30102_data *data = CONTAINER_OF(work, struct max30102_data, work);
+
+    max30102_thread_cb(data->dev);
+}
+#endif
+
+int max30102_trigger_set(const struct device *dev, const struct sensor_trigger *trig,
+    sensor_trigger_handler_t handler)
+{
+    struct max30102_data *data = dev->data;
+    const struct max30102_config *config = dev->config;
+    uint8_t int_sts;
+
+    if (trig->type != SENSOR_TRIG_FIFO_WATERMARK)
+    {
+        LOG_ERR("Unsupported sensor trigger");
+        return -ENOTSUP;
+    }
+
+    if (config->int_gpio.port == NULL)
+    {
+        LOG_ERR("Interrupt pin is not configured");
+        return -ENOTSUP;
+    }
+
+    if (gpio_pin_interrupt_configure_dt(&config->int_gpio, GPIO_INT_DISABLE))
+    {
+        return -EIO;
+    }
+
+    data->wm_handler = handler;
+    data->wm_trigger = trig;
+
+    if (handler == NULL)
+    {
+        return i2c_reg_write_byte_dt(&config->i2c, MAX30102_REG_INT_EN1, 0x00) ? -EIO : 0;
+    }
+
+    /* Flush the FIFO so that the first batch only holds fresh samples */
+    if (max30102_fifo_flush(dev))
+    {
+        return -EIO;
+    }
+
+    if (i2c_reg_write_byte_dt(&config->i2c, MAX30102_REG_INT_EN1, MAX30102_INT_A_FULL_MASK))
+    {
+        return -EIO;
+    }
+
+    /* Clear any interrupt which is still pending */
+    if (i2c_reg_read_byte_dt(&config->i2c, MAX30102_REG_INT_STS1, &int_sts))
+    {
+        return -EIO;
+    }
+
+    if (gpio_pin_interrupt_configure_dt(&config->int_gpio, GPIO_INT_EDGE_TO_ACTIVE))
+    {
+        return -EIO;
+    }
+
+    return 0;
+}
+
+int max30102_init_interrupt(const struct device *dev)
+{
+    struct max30102_data *data = dev->data;
+    const struct max30102_config *config = dev->config;
+    uint8_t int_sts;
+
+    if (config->int_gpio.port == NULL)
+    {
+        LOG_INF("Interrupt pin not defined, triggers are disabled");
+        return 0;
+    }
+
+    if (!gpio_is_ready_dt(&config->int_gpio))
+    {
+        LOG_ERR("GPIO device %s is not ready", config->int_gpio.port->name);
+        return -ENODEV;
+    }
+
+    /* The power ready interrupt cannot be masked, clear it after reset */
+    if (i2c_reg_read_byte_dt(&config->i2c, MAX30102_REG_INT_STS1, &int_sts))
+    {
+        return -EIO;
+    }
+
+    if (gpio_pin_configure_dt(&config->int_gpio, GPIO_INPUT))
+    {
+        LOG_ERR("Could not configure interrupt pin");
+        return -EIO;
+    }
+
+    gpio_init_callback(&data->gpio_cb, max30102_gpio_callback, BIT(config->int_gpio.pin));
+
+    if (gpio_add_callback(config->int_gpio.port, &data->gpio_cb))
+    {
+        LOG_ERR("Could not set GPIO callback");
+        return -EIO;
+    }
+
+#if defined(CONFIG_MAX30102_TRIGGER_OWN_THREAD)
+    k_sem_init(&data->gpio_sem, 0, K_SEM_MAX_LIMIT);
+
+    k_thread_create(&data->thread, data->thread_stack, CONFIG_MAX30102_THREAD_STACK_SIZE,
+        max30102_thread, data, NULL, NULL, K_PRIO_COOP(CONFIG_MAX30102_THREAD_PRIORITY),
+        0, K_NO_WAIT);
+    k_thread_name_set(&data->thread, "max30102");
+#elif defined(CONFIG_MAX30102_TRIGGER_GLOBAL_THREAD)
+    k_work_init(&data->work, max30102_work_cb);
+#endif
+
+    return 0;
+}
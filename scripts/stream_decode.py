@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: Apache-2.0
+"""Convert a capture of the binary sample stream to CSV.
+
+The capture is the raw content of the RTT up-buffer selected by
+CONFIG_APP_STREAM_RTT_CHANNEL, e.g. recorded with:
+
+    JLinkRTTLogger -Device NRF52832_XXAA -If SWD -Speed 4000 -RTTChannel 1 capture.bin
+
+The frame format is described in src/stream.h. Every PPG sample gets a
+row with its estimated uptime, every CO2 sample a row of its own.
+"""
+
+import argparse
+import csv
+import struct
+import sys
+
+SYNC = b"\x5a\xa5"
+HEADER = struct.Struct("<BBHI")
+CRC_SIZE = 2
+
+STREAM_PPG = 1
+STREAM_CO2 = 2
+
+PPG_PERIOD_MS = 10
+
+
+def crc16_ccitt(data, seed=0):
+    """Same computation as crc16_ccitt() of Zephyr."""
+    crc = seed
+    for byte in data:
+        e = (crc ^ byte) & 0xFF
+        f = (e ^ (e << 4)) & 0xFF
+        crc = ((crc >> 8) ^ (f << 8) ^ (f << 3) ^ (f >> 4)) & 0xFFFF
+    return crc
+
+
+def frames(data, stats):
+    """Yield (type, seq, time_ms, payload) for every valid frame."""
+    pos = 0
+    while True:
+        pos = data.find(SYNC, pos)
+        if pos < 0 or pos + len(SYNC) + HEADER.size > len(data):
+            return
+
+        start = pos + len(SYNC)
+        ftype, length, seq, time_ms = HEADER.unpack_from(data, start)
+        end = start + HEADER.size + length
+        if end + CRC_SIZE > len(data):
+            return
+
+        (crc,) = struct.unpack_from("<H", data, end)
+        if crc != crc16_ccitt(data[start:end]):
+            # A sync pattern inside a payload, or a torn frame
+            stats["crc_errors"] += 1
+            pos += 1
+            continue
+
+        yield ftype, seq, time_ms, data[start + HEADER.size:end]
+        pos = end + CRC_SIZE
+
+
+def ppg_rows(seq, time_ms, payload):
+    count = payload[0]
+    for i in range(count):
+        off = 1 + i * 6
+        red = int.from_bytes(payload[off:off + 3], "little")
+        ir = int.from_bytes(payload[off + 3:off + 6], "little")
+        # The block is stamped when read out, i.e. at its last sample
+        yield ["ppg", seq, time_ms - (count - 1 - i) * PPG_PERIOD_MS, red, ir, ""]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("capture", help="binary capture of the RTT channel")
+    parser.add_argument("-o", "--output", help="CSV file, standard output by default")
+    args = parser.parse_args()
+
+    with open(args.capture, "rb") as f:
+        data = f.read()
+
+    stats = {"frames": 0, "lost": 0, "crc_errors": 0}
+    last_seq = None
+    out = open(args.output, "w", newline="") if args.output else sys.stdout
+
+    try:
+        writer = csv.writer(out)
+        writer.writerow(["type", "seq", "time_ms", "red", "ir", "co2"])
+
+        for ftype, seq, time_ms, payload in frames(data, stats):
+            if last_seq is not None:
+                stats["lost"] += (seq - last_seq - 1) & 0xFFFF
+            last_seq = seq
+            stats["frames"] += 1
+
+            if ftype == STREAM_PPG:
+                writer.writerows(ppg_rows(seq, time_ms, payload))
+            elif ftype == STREAM_CO2:
+                (co2,) = struct.unpack_from("<H", payload)
+                writer.writerow(["co2", seq, time_ms, "", "", "%.2f" % (co2 / 100.0)])
+    finally:
+        if out is not sys.stdout:
+            out.close()
+
+    print("%(frames)d frames, %(lost)d lost, %(crc_errors)d CRC errors" % stats, file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -8,6 +8,10 @@ LOG_MODULE_REGISTER(button, CONFIG_LOG_DEFAULT_LEVEL);
 
 #include "button.h"
 
+#ifdef CONFIG_APP_SIM_BUTTONS
+#include <zephyr/drivers/gpio/gpio_emul.h>
+#endif
+
 /* Get buttons configuration from the devicetree aliases. */
 
 #define SPO2_BUTTON_NODE    DT_ALIAS(spo2button)
@@ -83,6 +87,45 @@ static void button_pressed(const struct device *dev, struct gpio_callback *cb, u
     user_callbacks[type]();
 }
 
+#ifdef CONFIG_APP_SIM_BUTTONS
+#define SIM_PRESS_TIME_MS    50
+
+static struct k_work_delayable sim_work;
+static bool sim_pressed;
+static bool sim_started;
+
+/*
+ * Press the emulated buttons periodically so that a host build runs the
+ * measurements without any input. In continuous SpO2 and capnography
+ * modes the buttons toggle the measurement, so they are only pressed once.
+ */
+static void button_sim_work_handler(struct k_work *item)
+{
+    bool press_spo2 = !IS_ENABLED(CONFIG_APP_SPO2_CONTINUOUS) || !sim_started;
+    bool press_co2 = !IS_ENABLED(CONFIG_APP_CO2_CAPNOGRAPHY) || !sim_started;
+
+    sim_pressed = !sim_pressed;
+
+    if (press_spo2)
+    {
+        gpio_emul_input_set(buttons[BUTTON_SPO2].port, buttons[BUTTON_SPO2].pin, sim_pressed);
+    }
+    if (press_co2)
+    {
+        gpio_emul_input_set(buttons[BUTTON_CO2].port, buttons[BUTTON_CO2].pin, sim_pressed);
+    }
+
+    if (sim_pressed)
+    {
+        k_work_schedule(&sim_work, K_MSEC(SIM_PRESS_TIME_MS));
+        return;
+    }
+
+    sim_started = true;
+    k_work_schedule(&sim_work, K_SECONDS(CONFIG_APP_SIM_BUTTON_PERIOD_S));
+}
+#endif
+
 void button_init(button_cb_t *user_button_cb)
 {
     int ret;
@@ -118,4 +161,25 @@ void button_init(button_cb_t *user_button_cb)
 
         k_timer_init(&debouncing_timer[i], button_timer_expiry, NULL);
     }
-}
\ No newline at end of file
+
+#ifdef CONFIG_APP_SIM_BUTTONS
+    k_work_init_delayable(&sim_work, button_sim_work_handler);
+    k_work_schedule(&sim_work, K_SECONDS(1));
+#endif
+}
+
+void button_wakeup_enable(void)
+{
+    for (uint8_t i = 0; i < BUTTON_TOP; i++)
+    {
+        k_timer_stop(&debouncing_timer[i]);
+
+        /* A level interrupt sets the pin sense, which System OFF wakes up on */
+        int ret = gpio_pin_interrupt_configure_dt(&buttons[i], GPIO_INT_LEVEL_ACTIVE);
+        if (ret != 0)
+        {
+            LOG_ERR("%d: failed to configure wake-up on %s pin %d\n", ret,
+                buttons[i].port->name, buttons[i].pin);
+        }
+    }
+}
@@ -15,4 +15,7 @@ enum button_type
 
 void button_init(button_cb_t *user_button_cb);
 
+/* Arm the buttons as wake-up sources right before System OFF */
+void button_wakeup_enable(void);
+
 #endif /* BUTTON_H */
\ No newline at end of file
@@ -0,0 +1,127 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include <zephyr/sys/util.h>
+
+#include "capno.h"
+
+/* A swing below 0.5 vol% is no breathing, e.g. the sensor is in room air */
+#define CAPNO_MIN_SWING          50
+#define CAPNO_MIN_SAMPLES        8
+
+/* Intervals outside of 4-60 breaths per minute are rejected */
+#define CAPNO_MIN_INTERVAL_MS    ((60 * 1000) / 60)
+#define CAPNO_MAX_INTERVAL_MS    ((60 * 1000) / 4)
+
+#define CAPNO_MIN_BREATHS        2
+
+void capno_reset(struct capno_detector *capno)
+{
+    memset(capno, 0, sizeof(*capno));
+}
+
+static void capno_interval_add(struct capno_detector *capno, uint32_t interval)
+{
+    if (capno->interval_cnt == CAPNO_INTERVALS)
+    {
+        capno->interval_sum -= capno->intervals[capno->interval_idx];
+    }
+    else
+    {
+        capno->interval_cnt++;
+    }
+
+    capno->intervals[capno->interval_idx] = interval;
+    capno->interval_sum += interval;
+    capno->interval_idx = (capno->interval_idx + 1) % CAPNO_INTERVALS;
+}
+
+static void capno_expiration_start(struct capno_detector *capno, uint32_t time_ms)
+{
+    uint32_t interval = time_ms - capno->last_breath_ms;
+
+    if (capno->last_breath_ms != 0)
+    {
+        if (interval > CAPNO_MAX_INTERVAL_MS)
+        {
+            /* Apnea or a lost signal, the rate starts over */
+            capno->interval_cnt = 0;
+            capno->interval_idx = 0;
+            capno->interval_sum = 0;
+        }
+        else if (interval >= CAPNO_MIN_INTERVAL_MS)
+        {
+            capno_interval_add(capno, interval);
+        }
+    }
+
+    capno->last_breath_ms = MAX(time_ms, 1);
+    capno->expiring = true;
+}
+
+bool capno_sample_add(struct capno_detector *capno, uint16_t co2, uint32_t time_ms)
+{
+    uint16_t min = UINT16_MAX;
+    uint16_t max = 0;
+    uint16_t swing;
+
+    capno->ring[capno->ring_idx] = co2;
+    capno->ring_idx = (capno->ring_idx + 1) % CAPNO_RING_SIZE;
+    capno->ring_cnt = MIN(capno->ring_cnt + 1, CAPNO_RING_SIZE);
+
+    if (capno->expiring)
+    {
+        capno->expiration_max = MAX(capno->expiration_max, co2);
+    }
+
+    if (capno->ring_cnt < CAPNO_MIN_SAMPLES)
+    {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < capno->ring_cnt; i++)
+    {
+        min = MIN(min, capno->ring[i]);
+        max = MAX(max, capno->ring[i]);
+    }
+
+    swing = max - min;
+    if (swing < CAPNO_MIN_SWING)
+    {
+        return false;
+    }
+
+    /* The gap between both thresholds keeps noise on the plateau or the
+     * baseline from splitting a breath in two.
+     */
+    if (!capno->expiring && (co2 > (min + (swing / 2))))
+    {
+        capno_expiration_start(capno, time_ms);
+        capno->expiration_max = co2;
+        return false;
+    }
+
+    if (capno->expiring && (co2 < (min + (swing / 4))))
+    {
+        capno->expiring = false;
+        capno->etco2 = capno->expiration_max;
+        return true;
+    }
+
+    return false;
+}
+
+uint16_t capno_etco2_get(const struct capno_detector *capno)
+{
+    return capno->etco2;
+}
+
+uint8_t capno_rr_get(const struct capno_detector *capno)
+{
+    if (capno->interval_cnt < CAPNO_MIN_BREATHS)
+    {
+        return 0;
+    }
+
+    return (uint8_t)((60 * 1000 * capno->interval_cnt + (capno->interval_sum / 2)) / capno->interval_sum);
+}
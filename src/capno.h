@@ -0,0 +1,45 @@
+#ifndef CAPNO_H
+#define CAPNO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* About 7.7 s of capnogram at the default 80 ms sampling period */
+#define CAPNO_RING_SIZE    96
+#define CAPNO_INTERVALS    4
+
+/*
+ * Streaming breath detector working on the CO2 samples in 1/100 vol%.
+ * The last CAPNO_RING_SIZE samples give the swing of the capnogram, an
+ * expiration starts when CO2 rises above 1/2 of it and ends when it
+ * falls below 1/4 of it. The end-tidal CO2 is the maximum of the
+ * expiration and the respiratory rate the mean of the last
+ * CAPNO_INTERVALS breath to breath intervals.
+ */
+struct capno_detector
+{
+    uint16_t ring[CAPNO_RING_SIZE];
+    uint8_t ring_idx;
+    uint8_t ring_cnt;
+    bool expiring;
+    uint16_t expiration_max;
+    uint16_t etco2;
+    uint32_t last_breath_ms;
+    uint32_t intervals[CAPNO_INTERVALS];
+    uint8_t interval_idx;
+    uint8_t interval_cnt;
+    uint32_t interval_sum;
+};
+
+void capno_reset(struct capno_detector *capno);
+
+/* Returns true when the sample ended an expiration, i.e. a breath */
+bool capno_sample_add(struct capno_detector *capno, uint16_t co2, uint32_t time_ms);
+
+/* End-tidal CO2 of the last breath in 1/100 vol%, 0 before the first one */
+uint16_t capno_etco2_get(const struct capno_detector *capno);
+
+/* Respiratory rate in breaths per minute, 0 until enough breaths were detected */
+uint8_t capno_rr_get(const struct capno_detector *capno);
+
+#endif /* CAPNO_H */
@@ -0,0 +1,11 @@
+#include <zephyr/zbus/zbus.h>
+
+#include "channels.h"
+
+ZBUS_CHAN_DEFINE(ppg_block_chan, struct ppg_block_msg, NULL, NULL, ZBUS_OBSERVERS_EMPTY, ZBUS_MSG_INIT(0));
+
+ZBUS_CHAN_DEFINE(spo2_chan, struct spo2_msg, NULL, NULL, ZBUS_OBSERVERS_EMPTY, ZBUS_MSG_INIT(0));
+
+ZBUS_CHAN_DEFINE(co2_raw_chan, struct co2_raw_msg, NULL, NULL, ZBUS_OBSERVERS_EMPTY, ZBUS_MSG_INIT(0));
+
+ZBUS_CHAN_DEFINE(etco2_chan, struct etco2_msg, NULL, NULL, ZBUS_OBSERVERS_EMPTY, ZBUS_MSG_INIT(0));
@@ -0,0 +1,50 @@
+#ifndef CHANNELS_H
+#define CHANNELS_H
+
+#include <stdint.h>
+
+#include <zephyr/zbus/zbus.h>
+
+#include "sample_block.h"
+
+/*
+ * Data plane between the producers and any number of consumers. The
+ * producers publish without knowing who listens; consumers attach their
+ * observers to the channels from their own module.
+ */
+
+/* Bounds how long a producer waits for a channel held by a reader */
+#define CHAN_PUB_TIMEOUT    K_MSEC(5)
+
+/*
+ * Raw PPG batch passed by reference. The block is only guaranteed to
+ * live during the notification; observers keeping it take a reference.
+ */
+struct ppg_block_msg
+{
+    struct sample_block *block;
+};
+
+struct spo2_msg
+{
+    uint8_t spo2;
+    uint8_t hr;
+};
+
+/* CO2 in 1/100 vol%, published from the acquisition queue */
+struct co2_raw_msg
+{
+    uint16_t co2;
+    uint32_t time_ms;
+};
+
+/* End-tidal CO2 in 1/100 vol% and respiratory rate of the last breath */
+struct etco2_msg
+{
+    uint16_t etco2;
+    uint8_t rr;
+};
+
+ZBUS_CHAN_DECLARE(ppg_block_chan, spo2_chan, co2_raw_chan, etco2_chan);
+
+#endif /* CHANNELS_H */
@@ -4,12 +4,22 @@
 #include <zephyr/drivers/sensor.h>
 
 #include <zephyr/logging/log.h>
-LOG_MODULE_REGISTER(co2, CONFIG_LOG_DEFAULT_LEVEL);
+LOG_MODULE_REGISTER(co2, CONFIG_APP_CO2_LOG_LEVEL);
 
-#include "display.h"
+#include "max30102.h"
+#include "stc31.h"
+
+#include "channels.h"
+#include "power.h"
+#include "sched.h"
+#include "capno.h"
 #include "co2.h"
 
-#define CO2_MEASUREMENT_PERIOD_S     1
+#ifdef CONFIG_APP_CO2_CAPNOGRAPHY
+#define CO2_MEASUREMENT_PERIOD       K_MSEC(CONFIG_APP_CO2_CAPNOGRAPHY_PERIOD_MS)
+#else
+#define CO2_MEASUREMENT_PERIOD       K_SECONDS(1)
+#endif
 
 enum co2_measurement_state
 {
@@ -23,6 +33,18 @@ enum co2_measurement_state
 struct co2_ctx
 {
     enum co2_measurement_state state;
+#ifdef CONFIG_APP_CO2_COMPENSATION
+    int64_t compensation_time;
+#endif
+#ifdef CONFIG_APP_CO2_CAPNOGRAPHY
+    struct capno_detector capno;
+#endif
+#ifdef CONFIG_APP_POWER
+    atomic_t powered;
+#endif
+    /* Start of the current session and the STC31 transaction count then, 0 when idle */
+    int64_t session_start;
+    uint32_t session_transactions;
     struct k_timer measurement_timer;
     struct k_work measurement_work;
     struct k_work button_pressed;
@@ -55,32 +77,109 @@ static const struct device *get_stc31_device(void)
     return dev;
 }
 
-static float co2_calculate(uint16_t raw_val)
+static void co2_measurement_timer_expiry(struct k_timer *timer_id)
 {
-    float co2 = (((float)raw_val - 16384.0) * 100) / 32768.0;
-    LOG_INF("CO2 val: %f", co2);
-    return (co2 > 0.0) ? co2 : 0.0;
+    sched_submit(SCHED_ACQ, &co2.measurement_work);
 }
 
-static void co2_measurement_timer_expiry(struct k_timer *timer_id)
+/* Nothing is requested anymore, the sensor sleeps until the next press */
+static void co2_idle(const struct device *dev)
 {
-    k_work_submit(&co2.measurement_work);
+    uint32_t transactions;
+    int64_t duration;
+    int err;
+
+    k_timer_stop(&co2.measurement_timer);
+
+    /* A measurement still running goes to sleep from its callback */
+    err = stc31_sleep(dev);
+    if (err == -EBUSY)
+    {
+        return;
+    }
+
+    if (err < 0)
+    {
+        LOG_ERR("Could not put the sensor to sleep\n");
+    }
+
+#ifdef CONFIG_APP_POWER
+    if (atomic_cas(&co2.powered, 1, 0))
+    {
+        power_measurement_stop(dev);
+    }
+#endif
+
+    if (co2.session_start == 0)
+    {
+        return;
+    }
+
+    /* The sleep command above is part of the session */
+    transactions = stc31_i2c_transactions_get(dev) - co2.session_transactions;
+    duration = k_uptime_get() - co2.session_start;
+    co2.session_start = 0;
+
+    LOG_INF("STC31: %u I2C transactions in %u s, %u per hour", transactions, (uint32_t)(duration / MSEC_PER_SEC),
+        (uint32_t)(((uint64_t)transactions * 3600 * MSEC_PER_SEC) / MAX(duration, 1)));
 }
 
-static void co2_measurement_complete_workqueue(struct k_work *item)
+/* Every reading goes out on the raw CO2 channel, in 1/100 vol% */
+static uint16_t co2_raw_publish(uint16_t raw_val)
 {
-    const struct device *dev = get_stc31_device();
+    struct co2_raw_msg msg =
+    {
+        .co2 = (uint16_t)(co2_calculate(raw_val) * 100.0f),
+        .time_ms = k_uptime_get_32(),
+    };
 
-    if (dev == NULL)
+    if (zbus_chan_pub(&co2_raw_chan, &msg, CHAN_PUB_TIMEOUT) < 0)
+    {
+        LOG_WRN("Could not publish the CO2 reading");
+    }
+
+    return msg.co2;
+}
+
+#ifdef CONFIG_APP_CO2_CAPNOGRAPHY
+/* Feed the capnogram to the breath detector and publish every breath */
+static void co2_capno_sample_add(uint16_t raw_val)
+{
+    uint16_t val = co2_raw_publish(raw_val);
+
+    if (!capno_sample_add(&co2.capno, val, k_uptime_get_32()))
     {
         return;
     }
 
+    struct etco2_msg msg = {.etco2 = capno_etco2_get(&co2.capno), .rr = capno_rr_get(&co2.capno)};
+
+    LOG_INF("EtCO2: %u.%02u %%, RR: %u/min", msg.etco2 / 100, msg.etco2 % 100, msg.rr);
+
+    if (zbus_chan_pub(&etco2_chan, &msg, CHAN_PUB_TIMEOUT) < 0)
+    {
+        LOG_WRN("Could not publish the breath");
+    }
+}
+#endif
+
+static void co2_measurement_done(const struct device *dev, int err, void *user_data)
+{
     struct sensor_value data;
 
-    if (sensor_sample_fetch(dev) < 0)
+#ifdef CONFIG_APP_CO2_CAPNOGRAPHY
+    /* Stopped while this measurement was running */
+    if (co2.state == CO2_MEAS_NONE)
+    {
+        co2_idle(dev);
+        return;
+    }
+#endif
+
+    if (err < 0)
     {
         LOG_ERR("Error when fetching the data\n");
+        return;
     }
 
     if (sensor_channel_get(dev, SENSOR_CHAN_CO2, &data) < 0)
@@ -92,31 +191,190 @@ static void co2_measurement_complete_workqueue(struct k_work *item)
     switch (co2.state)
     {
         case CO2_MEAS_REQUESTED:
+#ifdef CONFIG_APP_CO2_CAPNOGRAPHY
+            capno_reset(&co2.capno);
+#endif
             co2.state = CO2_MEAS_STARTED;
             break;
+#ifdef CONFIG_APP_CO2_CAPNOGRAPHY
+        case CO2_MEAS_STARTED:
+            co2_capno_sample_add(data.val1);
+            break;
+#else
         case CO2_MEAS_STARTED:
-            display_print(SENSOR_CO2, co2_calculate(data.val1));
+        {
+            uint16_t val = co2_raw_publish(data.val1);
+
+            LOG_INF("CO2 val: %u.%02u %%", val / 100, val % 100);
             co2.state = CO2_MEAS_NONE;
+            co2_idle(dev);
             break;
+        }
+#endif
         case CO2_MEAS_NONE:
         default:
             break;
     }
 }
 
-void co2_button_pressed(void)
+#ifdef CONFIG_APP_CO2_COMPENSATION
+/* Runs on the acquisition queue like the measurement start, user_data is the STC31 */
+static void co2_die_temp_done(const struct device *temp_dev, int err, void *user_data)
+{
+    const struct device *dev = user_data;
+    struct sensor_value temp;
+
+    if ((err < 0) || (sensor_channel_get(temp_dev, SENSOR_CHAN_DIE_TEMP, &temp) < 0))
+    {
+        LOG_WRN("Could not read the die temperature");
+        return;
+    }
+
+    /* A failed readout is retried with the next measurement */
+    co2.compensation_time = k_uptime_get();
+
+    /* Sent with the next measurement */
+    if (sensor_attr_set(dev, SENSOR_CHAN_CO2, (enum sensor_attribute)SENSOR_ATTR_STC31_TEMPERATURE, &temp) < 0)
+    {
+        LOG_WRN("Could not set the temperature compensation");
+    }
+}
+
+/*
+ * Forward the MAX30102 die temperature to the STC31 temperature
+ * compensation. The driver only writes it to the sensor when it moved
+ * beyond its threshold, so most updates cost no STC31 traffic at all.
+ * The conversion takes about 30 ms and completes in co2_die_temp_done(),
+ * so the measurement is not held up by it.
+ */
+static void co2_compensation_update(const struct device *dev)
+{
+    const struct device *temp_dev = DEVICE_DT_GET_ANY(maxim_max30102);
+    int err;
+
+    if ((co2.compensation_time != 0) &&
+        ((k_uptime_get() - co2.compensation_time) < (CONFIG_APP_CO2_COMPENSATION_PERIOD_S * MSEC_PER_SEC)))
+    {
+        return;
+    }
+
+    if ((temp_dev == NULL) || !device_is_ready(temp_dev))
+    {
+        return;
+    }
+
+    /* -EBUSY: the previous readout has not completed yet */
+    err = max30102_die_temp_start(temp_dev, co2_die_temp_done, (void *)dev);
+    if ((err < 0) && (err != -EBUSY))
+    {
+        LOG_WRN("Could not read the die temperature");
+    }
+}
+#endif
+
+static void co2_measurement_start_workqueue(struct k_work *item)
+{
+    const struct device *dev = get_stc31_device();
+
+    if ((dev == NULL) || (co2.state == CO2_MEAS_NONE))
+    {
+        return;
+    }
+
+    /* The transactions are counted from the first period on, including the wake-up */
+    if (co2.session_start == 0)
+    {
+        co2.session_start = k_uptime_get();
+        co2.session_transactions = stc31_i2c_transactions_get(dev);
+    }
+
+#ifdef CONFIG_APP_POWER
+    /* The first period of a measurement resumes the bus, co2_idle() releases it */
+    if (atomic_cas(&co2.powered, 0, 1))
+    {
+        power_measurement_start(dev);
+    }
+#endif
+
+#ifdef CONFIG_APP_CO2_COMPENSATION
+    co2_compensation_update(dev);
+#endif
+
+    /* The driver calls back once the result is ready, nothing blocks here */
+    int err = stc31_measurement_start(dev, co2_measurement_done, NULL);
+
+    /* A period during which the previous measurement still runs is skipped */
+    if ((err < 0) && (err != -EBUSY))
+    {
+        LOG_ERR("Could not start the measurement\n");
+    }
+}
+
+/*
+ * Queued behind any pending measurement work, so that a stop followed by
+ * a start is always handled in that order.
+ */
+static void co2_button_pressed_workqueue(struct k_work *item)
 {
     if (co2.state != CO2_MEAS_NONE)
     {
+#ifdef CONFIG_APP_CO2_CAPNOGRAPHY
+        const struct device *dev = get_stc31_device();
+
+        /* The button toggles the continuous measurement */
+        co2.state = CO2_MEAS_NONE;
+        k_timer_stop(&co2.measurement_timer);
+        if (dev != NULL)
+        {
+            co2_idle(dev);
+        }
+#endif
         return;
     }
 
     co2.state = CO2_MEAS_REQUESTED;
+
+    /* The timer only runs while a measurement is requested */
+    k_timer_start(&co2.measurement_timer, K_NO_WAIT, CO2_MEASUREMENT_PERIOD);
+}
+
+void co2_button_pressed(void)
+{
+    /* Called from the GPIO interrupt, the CO2 state is only touched from the acquisition queue */
+    sched_submit(SCHED_ACQ, &co2.button_pressed);
 }
 
 void co2_init(void)
 {
     k_timer_init(&co2.measurement_timer, co2_measurement_timer_expiry, NULL);
-    k_work_init(&co2.measurement_work, co2_measurement_complete_workqueue);
-    k_timer_start(&co2.measurement_timer, K_SECONDS(CO2_MEASUREMENT_PERIOD_S), K_SECONDS(CO2_MEASUREMENT_PERIOD_S));
+    k_work_init(&co2.measurement_work, co2_measurement_start_workqueue);
+    k_work_init(&co2.button_pressed, co2_button_pressed_workqueue);
+
+    const struct device *dev = get_stc31_device();
+
+    if (dev == NULL)
+    {
+        return;
+    }
+
+    /* The readout and its callback run next to the measurement start, so
+     * the whole CO2 state is only touched from the acquisition queue.
+     */
+    stc31_work_queue_set(dev, sched_queue_get(SCHED_ACQ));
+
+#ifdef CONFIG_APP_CO2_COMPENSATION
+    const struct device *temp_dev = DEVICE_DT_GET_ANY(maxim_max30102);
+
+    /* The die temperature for the compensation completes there too */
+    if ((temp_dev != NULL) && device_is_ready(temp_dev))
+    {
+        max30102_work_queue_set(temp_dev, sched_queue_get(SCHED_ACQ));
+    }
+#endif
+
+    /* The sensor sleeps until the first measurement is requested */
+    if (stc31_sleep(dev) < 0)
+    {
+        LOG_ERR("Could not put the sensor to sleep\n");
+    }
 }
@@ -1,6 +1,16 @@
 #ifndef CO2_H
 #define CO2_H
 
+#include <stdint.h>
+
+/* CO2 concentration in vol% from the raw STC31 gas ticks */
+static inline float co2_calculate(uint16_t raw_val)
+{
+    float co2 = (((float)raw_val - 16384.0f) * 100) / 32768.0f;
+
+    return (co2 > 0.0f) ? co2 : 0.0f;
+}
+
 void co2_button_pressed(void);
 void co2_init(void);
 
@@ -6,83 +6,559 @@
 #include <stdio.h>
 #include <string.h>
 #include <zephyr/kernel.h>
+#include <zephyr/pm/device.h>
+#include <zephyr/zbus/zbus.h>
 
 #include <zephyr/logging/log.h>
-LOG_MODULE_REGISTER(display, CONFIG_LOG_DEFAULT_LEVEL);
+LOG_MODULE_REGISTER(display, CONFIG_APP_DISPLAY_LOG_LEVEL);
 
+#include "channels.h"
 #include "display.h"
+#include "wave.h"
 
 #define SENSOR_VAL_OFFSET_X    70
-#define SPO2_TEXT_OFFSET_X     16
-#define CO2_TEXT_OFFSET_X      25
-#define SPO2_OFFSET_Y          14
-#define CO2_OFFSET_Y           40
 
+#ifdef CONFIG_APP_WAVEFORM
+#define DISPLAY_FRAME_MS       MIN(CONFIG_APP_DISPLAY_REFRESH_MS, 1000 / CONFIG_APP_WAVEFORM_FPS)
+#else
+#define DISPLAY_FRAME_MS       CONFIG_APP_DISPLAY_REFRESH_MS
+#endif
+
+struct display_field
+{
+    bool shown;
+    const char *caption;
+    lv_coord_t caption_x;
+    lv_coord_t value_x;
+    lv_coord_t y;
+};
+
+#if defined(CONFIG_APP_WAVEFORM)
+/*
+ * The values share the 16 px top row in the 10 px font, without their
+ * units, and the waveforms take the rest of the screen. The positions
+ * are computed from the text sizes by display_row_layout().
+ */
+static const struct display_field display_fields[SENSOR_TOP] =
+{
+    [SENSOR_SPO2] = {true, "SpO2", 0, 0, 2},
+    [SENSOR_HR] = {true, "HR", 0, 0, 2},
+    [SENSOR_CO2] = {true, "CO2", 0, 0, 2},
+};
+
+/* The widest text of each value, as printed by display_value_set() */
+static const char *const display_widest[SENSOR_TOP] =
+{
+    [SENSOR_SPO2] = "100",
+    [SENSOR_HR] = "250",
+    [SENSOR_CO2] = "99.9",
+};
+
+#define DISPLAY_ROW_FONT       (&lv_font_montserrat_10)
+/* Between a caption and its value */
+#define DISPLAY_CAPTION_GAP    3
+#elif defined(CONFIG_APP_CO2_CAPNOGRAPHY)
+/* Four rows of the 16 px font fill the 64 px of the screen */
+static const struct display_field display_fields[SENSOR_TOP] =
+{
+    [SENSOR_SPO2] = {true, "SpO2 :", 16, SENSOR_VAL_OFFSET_X, 0},
+    [SENSOR_HR] = {true, "HR :", 33, SENSOR_VAL_OFFSET_X, 16},
+    [SENSOR_CO2] = {true, "EtCO2 :", 9, SENSOR_VAL_OFFSET_X, 32},
+    [SENSOR_RR] = {true, "RR :", 33, SENSOR_VAL_OFFSET_X, 48},
+};
+#else
+static const struct display_field display_fields[SENSOR_TOP] =
+{
+    [SENSOR_SPO2] = {true, "SpO2 :", 16, SENSOR_VAL_OFFSET_X, 4},
+    [SENSOR_HR] = {true, "HR :", 33, SENSOR_VAL_OFFSET_X, 24},
+    [SENSOR_CO2] = {true, "CO2 :", 25, SENSOR_VAL_OFFSET_X, 44},
+};
+#endif
+
+#define DISPLAY_TEXT_LEN               16
+#define DISPLAY_STATS_REPORT_FRAMES    64
+
+/* A frame request carries no value, it only asks for the waveforms */
+#define DISPLAY_MSG_FRAME              SENSOR_NONE
+#define DISPLAY_MSG_SLEEP              SENSOR_TOP
+#define DISPLAY_MSG_WAKE               (SENSOR_TOP + 1)
+
+#if defined(CONFIG_PM_DEVICE) && DT_ON_BUS(DT_CHOSEN(zephyr_display), spi)
+#define DISPLAY_BUS                    DEVICE_DT_GET(DT_BUS(DT_CHOSEN(zephyr_display)))
+#endif
+
+struct display_msg
+{
+    uint8_t type;
+    float val;
+};
+
+K_THREAD_STACK_DEFINE(display_stack, CONFIG_APP_UI_STACK_SIZE);
+K_MSGQ_DEFINE(display_msgq, sizeof(struct display_msg), CONFIG_APP_UI_MSGQ_SIZE, 4);
 
 struct display_ctx
 {
     const struct device *device;
-    lv_obj_t *spo2_label;
-    lv_obj_t *co2_label;
+    lv_obj_t *label[SENSOR_TOP];
+    lv_coord_t caption_x[SENSOR_TOP];
+    lv_coord_t value_x[SENSOR_TOP];
+    char text[SENSOR_TOP][DISPLAY_TEXT_LEN];
+    float value[SENSOR_TOP];
+    uint32_t pending;
+    bool frame_requested;
+    bool asleep;
+    int64_t last_frame;
+    int64_t next_timer;
+    atomic_t dropped;
+    struct k_thread thread;
+    struct k_spinlock stats_lock;
+    struct display_stats stats;
+#ifdef CONFIG_APP_DISPLAY_STATS
+    void (*flush_cb)(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_p);
+    uint32_t frame_flushes;
+    uint32_t frame_bytes;
+#endif
 };
 
 static struct display_ctx display;
 
-void display_init(void)
+#ifdef CONFIG_APP_DISPLAY_STATS
+/*
+ * LVGL only flushes the invalidated areas, rounded to whole pages by the
+ * SSD1306 glue, so the bytes of the flushed areas are what goes over SPI
+ * apart from the few addressing commands.
+ */
+static void display_flush_cb(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_p)
 {
-    lv_obj_t *spo2_label;
-    lv_obj_t *co2_label;
+    uint32_t width = area->x2 - area->x1 + 1;
+    uint32_t height = area->y2 - area->y1 + 1;
 
-    display.device = DEVICE_DT_GET(DT_CHOSEN(zephyr_display));
-    if (!device_is_ready(display.device))
+    display.frame_flushes++;
+    display.frame_bytes += ((width * height * LV_COLOR_DEPTH) + 7) / 8;
+    display.flush_cb(drv, area, color_p);
+}
+
+static void display_stats_init(void)
+{
+    lv_disp_t *disp = lv_disp_get_default();
+
+    if ((disp == NULL) || (disp->driver->flush_cb == NULL))
     {
-        LOG_ERR("Device is not ready");
+        LOG_WRN("Display flushes cannot be counted");
         return;
     }
 
+    display.flush_cb = disp->driver->flush_cb;
+    disp->driver->flush_cb = display_flush_cb;
+}
+
+static void display_stats_record(uint32_t render_us)
+{
+    k_spinlock_key_t key = k_spin_lock(&display.stats_lock);
+    struct display_stats *stats = &display.stats;
+
+    stats->frames++;
+    stats->dropped = (uint32_t)atomic_get(&display.dropped);
+    stats->flushes += display.frame_flushes;
+    stats->bytes += display.frame_bytes;
+    stats->render_us_max = MAX(stats->render_us_max, render_us);
+    stats->render_us_sum += render_us;
+    k_spin_unlock(&display.stats_lock, key);
+
+    LOG_DBG("Frame: %u us, %u bytes in %u flushes", render_us, display.frame_bytes, display.frame_flushes);
+
+    if ((stats->frames % DISPLAY_STATS_REPORT_FRAMES) == 0)
+    {
+        LOG_INF("Display: %u frames, %u unchanged values, %u dropped messages, queue peak %u, "
+                "%u bytes per frame, render mean %u us, max %u us",
+            stats->frames, stats->skipped, stats->dropped, stats->queue_peak,
+            stats->bytes / stats->frames, (uint32_t)(stats->render_us_sum / stats->frames),
+            stats->render_us_max);
+    }
+}
+#endif
+
+#ifdef CONFIG_APP_WAVEFORM
+static lv_coord_t display_text_width(const char *text)
+{
+    lv_point_t size;
+
+    lv_txt_get_size(&size, text, DISPLAY_ROW_FONT, 0, 0, LV_COORD_MAX, LV_TEXT_FLAG_NONE);
+
+    return size.x;
+}
+
+/*
+ * Each field takes the width of its caption and of its widest value, the
+ * space left over is spread evenly between the fields.
+ */
+static void display_row_layout(void)
+{
+    lv_coord_t width[SENSOR_TOP] = {0};
+    lv_coord_t used = 0;
+    lv_coord_t spare;
+    lv_coord_t x = 0;
+    int fields = 0;
+
+    for (uint8_t type = SENSOR_NONE + 1; type < SENSOR_TOP; type++)
+    {
+        if (display_fields[type].shown)
+        {
+            display.value_x[type] = display_text_width(display_fields[type].caption) + DISPLAY_CAPTION_GAP;
+            width[type] = display.value_x[type] + display_text_width(display_widest[type]);
+            used += width[type];
+            fields++;
+        }
+    }
+
+    spare = lv_disp_get_hor_res(NULL) - used;
+    if (spare < 0)
+    {
+        LOG_WRN("Top row is %d px too wide", -spare);
+        spare = 0;
+    }
+
+    for (uint8_t type = SENSOR_NONE + 1; type < SENSOR_TOP; type++)
+    {
+        if (display_fields[type].shown)
+        {
+            display.caption_x[type] = x;
+            display.value_x[type] += x;
+            x += width[type] + ((fields > 1) ? (spare / (fields - 1)) : 0);
+        }
+    }
+}
+#endif
+
+static lv_obj_t *display_label_create(const char *text, lv_coord_t x, lv_coord_t y)
+{
+    lv_obj_t *label = lv_label_create(lv_scr_act());
+
+#ifdef CONFIG_APP_WAVEFORM
+    lv_obj_set_style_text_font(label, DISPLAY_ROW_FONT, LV_PART_MAIN);
+#endif
+    lv_label_set_text(label, text);
+    lv_obj_align(label, LV_ALIGN_TOP_LEFT, x, y);
+
+    return label;
+}
+
+static void display_screen_init(void)
+{
     lv_obj_clean(lv_scr_act());
 
-    spo2_label = lv_label_create(lv_scr_act());
-    co2_label = lv_label_create(lv_scr_act());
+#ifdef CONFIG_APP_WAVEFORM
+    display_row_layout();
+#else
+    for (uint8_t type = SENSOR_NONE + 1; type < SENSOR_TOP; type++)
+    {
+        display.caption_x[type] = display_fields[type].caption_x;
+        display.value_x[type] = display_fields[type].value_x;
+    }
+#endif
+
+    for (uint8_t type = SENSOR_NONE + 1; type < SENSOR_TOP; type++)
+    {
+        const struct display_field *field = &display_fields[type];
+
+        if (field->shown && (field->caption != NULL))
+        {
+            display_label_create(field->caption, display.caption_x[type], field->y);
+        }
+    }
 
-    lv_label_set_text(spo2_label, "SpO2 :");
-    lv_obj_align(spo2_label, LV_ALIGN_TOP_LEFT, SPO2_TEXT_OFFSET_X, SPO2_OFFSET_Y);
+#ifdef CONFIG_APP_WAVEFORM
+    wave_init(lv_scr_act());
+#endif
 
-    lv_label_set_text(co2_label, "CO2 :");
-    lv_obj_align(co2_label, LV_ALIGN_TOP_LEFT, CO2_TEXT_OFFSET_X, CO2_OFFSET_Y);
+#ifdef CONFIG_APP_DISPLAY_STATS
+    display_stats_init();
+#endif
 
     lv_task_handler();
     display_blanking_off(display.device);
 
-    display.spo2_label = lv_label_create(lv_scr_act());
-    lv_label_set_text(display.spo2_label, "");
-    lv_obj_align(display.spo2_label, LV_ALIGN_TOP_LEFT, SENSOR_VAL_OFFSET_X, SPO2_OFFSET_Y);
+    for (uint8_t type = SENSOR_NONE + 1; type < SENSOR_TOP; type++)
+    {
+        const struct display_field *field = &display_fields[type];
 
-    display.co2_label = lv_label_create(lv_scr_act());
-    lv_label_set_text(display.co2_label, "");
-    lv_obj_align(display.co2_label, LV_ALIGN_TOP_LEFT, SENSOR_VAL_OFFSET_X, CO2_OFFSET_Y);
+        if (field->shown)
+        {
+            display.label[type] = display_label_create("", display.value_x[type], field->y);
+        }
+    }
 }
 
-void display_print(enum sensor_type type, float val)
+/*
+ * The labels are left aligned and never move, so an update only touches
+ * the label text and LVGL invalidates the area of that label alone.
+ */
+static void display_value_set(enum sensor_type type, float val)
 {
     uint16_t integer = (uint16_t)val;
-    uint16_t fraction = ((uint16_t)(val * 100.0) % 100);
+    uint16_t fraction = ((uint16_t)(val * 100.0f) % 100);
+    char text[DISPLAY_TEXT_LEN];
 
+    if (display.label[type] == NULL)
+    {
+        return;
+    }
+
+#ifdef CONFIG_APP_WAVEFORM
+    /* No room for the units on the top row */
+    if (type == SENSOR_CO2)
+    {
+        snprintf(text, sizeof(text), "%d.%d", integer, fraction / 10);
+    }
+    else
+    {
+        snprintf(text, sizeof(text), "%d", (uint16_t)val);
+    }
+#else
     switch (type)
     {
         case SENSOR_SPO2:
-            lv_label_set_text_fmt(display.spo2_label, "%d %%", (uint16_t)val);
-            lv_obj_align(display.spo2_label, LV_ALIGN_TOP_LEFT, SENSOR_VAL_OFFSET_X, SPO2_OFFSET_Y);
+            snprintf(text, sizeof(text), "%d %%", (uint16_t)val);
+            break;
+        case SENSOR_HR:
+            snprintf(text, sizeof(text), "%d bpm", (uint16_t)val);
             break;
         case SENSOR_CO2:
-            lv_label_set_text_fmt(display.co2_label, "%d. %d %%", integer, fraction);
-            lv_obj_align(display.co2_label, LV_ALIGN_TOP_LEFT, SENSOR_VAL_OFFSET_X, CO2_OFFSET_Y);
+            snprintf(text, sizeof(text), "%d. %d %%", integer, fraction);
+            break;
+        case SENSOR_RR:
+            snprintf(text, sizeof(text), "%d /min", (uint16_t)val);
             break;
 
         default:
-            break;
+            return;
     }
+#endif
 
-    lv_task_handler();
-    display_blanking_off(display.device);
-}
\ No newline at end of file
+    if (strcmp(text, display.text[type]) == 0)
+    {
+        k_spinlock_key_t key = k_spin_lock(&display.stats_lock);
+
+        display.stats.skipped++;
+        k_spin_unlock(&display.stats_lock, key);
+        return;
+    }
+
+    strcpy(display.text[type], text);
+    lv_label_set_text(display.label[type], text);
+}
+
+/* All the values and waveform points received since the previous frame */
+static void display_frame_render(void)
+{
+#ifdef CONFIG_APP_DISPLAY_STATS
+    uint32_t start = k_cycle_get_32();
+
+    display.frame_flushes = 0;
+    display.frame_bytes = 0;
+#endif
+
+    for (uint8_t type = SENSOR_NONE + 1; type < SENSOR_TOP; type++)
+    {
+        if (display.pending & BIT(type))
+        {
+            display_value_set(type, display.value[type]);
+        }
+    }
+
+    display.pending = 0;
+
+#ifdef CONFIG_APP_WAVEFORM
+    wave_render();
+#endif
+
+    /* Draw the invalidated areas now rather than on the next LVGL timer */
+    lv_refr_now(NULL);
+
+#ifdef CONFIG_APP_DISPLAY_STATS
+    display_stats_record(k_cyc_to_us_near32(k_cycle_get_32() - start));
+#endif
+}
+
+/*
+ * The panel keeps its RAM while off, so waking up only needs the values
+ * received meanwhile to be drawn.
+ */
+static void display_sleep_set(bool sleep)
+{
+    if (sleep == display.asleep)
+    {
+        return;
+    }
+
+    if (sleep)
+    {
+        display_blanking_on(display.device);
+#ifdef DISPLAY_BUS
+        pm_device_action_run(DISPLAY_BUS, PM_DEVICE_ACTION_SUSPEND);
+#endif
+    }
+    else
+    {
+#ifdef DISPLAY_BUS
+        pm_device_action_run(DISPLAY_BUS, PM_DEVICE_ACTION_RESUME);
+#endif
+        display_blanking_off(display.device);
+    }
+
+    display.asleep = sleep;
+}
+
+static void display_msg_handle(const struct display_msg *msg)
+{
+    if ((msg->type == DISPLAY_MSG_SLEEP) || (msg->type == DISPLAY_MSG_WAKE))
+    {
+        display_sleep_set(msg->type == DISPLAY_MSG_SLEEP);
+        display.frame_requested = !display.asleep;
+        return;
+    }
+
+    if ((msg->type > SENSOR_NONE) && (msg->type < SENSOR_TOP))
+    {
+        display.value[msg->type] = msg->val;
+        display.pending |= BIT(msg->type);
+    }
+
+    display.frame_requested = true;
+}
+
+/*
+ * The UI thread is the only context touching LVGL. It renders at most
+ * one frame per frame interval, so messages arriving close together
+ * share a frame, and runs the LVGL timers on its own slower cadence as
+ * nothing on the screen is animated.
+ */
+static void display_thread(void *p1, void *p2, void *p3)
+{
+    display_screen_init();
+    display.next_timer = k_uptime_get() + CONFIG_APP_UI_TIMER_PERIOD_MS;
+
+    while (1)
+    {
+        int64_t now = k_uptime_get();
+        int64_t next_frame = display.last_frame + DISPLAY_FRAME_MS;
+        int64_t deadline = display.frame_requested ? MIN(next_frame, display.next_timer) : display.next_timer;
+        struct display_msg msg;
+
+        /* Asleep, nothing is drawn and the LVGL timers do not run either */
+        if (display.asleep)
+        {
+            k_msgq_get(&display_msgq, &msg, K_FOREVER);
+            display_msg_handle(&msg);
+            continue;
+        }
+
+        if (display.frame_requested && (now >= next_frame))
+        {
+            display.frame_requested = false;
+            display.last_frame = now;
+            display_frame_render();
+            continue;
+        }
+
+        if (now >= display.next_timer)
+        {
+            lv_timer_handler();
+            display.next_timer = now + CONFIG_APP_UI_TIMER_PERIOD_MS;
+            continue;
+        }
+
+        if (k_msgq_get(&display_msgq, &msg, K_MSEC(deadline - now)) == 0)
+        {
+            uint32_t queued = k_msgq_num_used_get(&display_msgq) + 1;
+
+            display.stats.queue_peak = MAX(display.stats.queue_peak, queued);
+            display_msg_handle(&msg);
+        }
+    }
+}
+
+static void display_post(uint8_t type, float val)
+{
+    struct display_msg msg = {.type = type, .val = val};
+
+    /* Never block the sensor paths, a value lost is replaced by the next */
+    if (k_msgq_put(&display_msgq, &msg, K_NO_WAIT) < 0)
+    {
+        atomic_inc(&display.dropped);
+    }
+}
+
+/* Runs in the publisher context, so it only posts to the UI thread */
+static void display_chan_cb(const struct zbus_channel *chan)
+{
+    if (chan == &spo2_chan)
+    {
+        const struct spo2_msg *msg = zbus_chan_const_msg(chan);
+
+        display_post(SENSOR_SPO2, msg->spo2);
+        display_post(SENSOR_HR, msg->hr);
+    }
+    else if (chan == &etco2_chan)
+    {
+        const struct etco2_msg *msg = zbus_chan_const_msg(chan);
+
+        display_post(SENSOR_CO2, msg->etco2 / 100.0f);
+        display_post(SENSOR_RR, msg->rr);
+    }
+    else if (chan == &co2_raw_chan)
+    {
+        const struct co2_raw_msg *msg = zbus_chan_const_msg(chan);
+
+        display_post(SENSOR_CO2, msg->co2 / 100.0f);
+    }
+}
+
+ZBUS_LISTENER_DEFINE(display_lis, display_chan_cb);
+
+ZBUS_CHAN_ADD_OBS(spo2_chan, display_lis, 0);
+#ifdef CONFIG_APP_CO2_CAPNOGRAPHY
+/* The CO2 field shows the end-tidal value, not the capnogram */
+ZBUS_CHAN_ADD_OBS(etco2_chan, display_lis, 0);
+#else
+ZBUS_CHAN_ADD_OBS(co2_raw_chan, display_lis, 0);
+#endif
+
+void display_init(void)
+{
+    display.device = DEVICE_DT_GET(DT_CHOSEN(zephyr_display));
+    if (!device_is_ready(display.device))
+    {
+        LOG_ERR("Device is not ready");
+        return;
+    }
+
+    k_thread_create(&display.thread, display_stack, K_THREAD_STACK_SIZEOF(display_stack), display_thread,
+        NULL, NULL, NULL, CONFIG_APP_UI_PRIORITY, 0, K_NO_WAIT);
+    k_thread_name_set(&display.thread, "ui");
+}
+
+void display_power_set(bool on)
+{
+    struct display_msg msg = {.type = on ? DISPLAY_MSG_WAKE : DISPLAY_MSG_SLEEP};
+
+    /* Unlike the values, a power change must not be lost */
+    if (k_msgq_put(&display_msgq, &msg, K_MSEC(100)) < 0)
+    {
+        LOG_WRN("Display power change lost");
+    }
+}
+
+void display_frame_request(void)
+{
+    display_post(DISPLAY_MSG_FRAME, 0.0f);
+}
+
+void display_stats_get(struct display_stats *stats)
+{
+    k_spinlock_key_t key = k_spin_lock(&display.stats_lock);
+
+    *stats = display.stats;
+    stats->dropped = (uint32_t)atomic_get(&display.dropped);
+    k_spin_unlock(&display.stats_lock, key);
+}
@@ -1,17 +1,50 @@
 #ifndef DISPLAY_H
 #define DISPLAY_H
 
+#include <stdbool.h>
+#include <stdint.h>
+
 enum sensor_type
 {
     SENSOR_NONE,
     SENSOR_SPO2,
     SENSOR_CO2,
+    SENSOR_HR,
+    SENSOR_RR,
 
     SENSOR_TOP,
 };
 
+struct display_stats
+{
+    uint32_t frames;
+    uint32_t skipped;
+    uint32_t dropped;
+    uint32_t queue_peak;
+    uint32_t flushes;
+    uint32_t bytes;
+    uint32_t render_us_max;
+    uint64_t render_us_sum;
+};
+
+/*
+ * Start the UI thread, which builds the screen and then owns LVGL. The
+ * values come from the SpO2 and CO2 channels and are posted to the UI
+ * thread without blocking the publisher; when the queue is full the
+ * value is dropped and counted.
+ */
 void display_init(void);
 
-void display_print(enum sensor_type type, float val);
+/* Blank the panel and suspend its bus, or wake it up with the latest values */
+void display_power_set(bool on);
+
+/* Render a frame within the frame interval, e.g. for new waveform samples */
+void display_frame_request(void);
+
+/*
+ * Rendering statistics. The frame count, flushed bytes and render times
+ * are only collected with APP_DISPLAY_STATS.
+ */
+void display_stats_get(struct display_stats *stats);
 
 #endif /* DISPLAY_H */
\ No newline at end of file
@@ -0,0 +1,110 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include <zephyr/sys/util.h>
+
+#include "spo2_window.h"
+#include "hr.h"
+
+#define HR_SAMPLE_RATE_HZ       (1000 / SPO2_SAMPLING_TIME_MS)
+
+/* The DC tracker cutoff is about fs / (2 * pi * 2^6) = 0.25 Hz */
+#define HR_DC_SHIFT             6
+/* The low-pass cutoff is about fs / (2 * pi * 2^2) = 4 Hz */
+#define HR_LP_SHIFT             2
+/* The envelope decays with a time constant of 2^7 samples */
+#define HR_ENVELOPE_SHIFT       7
+
+/* Intervals outside of 30-200 bpm are rejected */
+#define HR_MIN_INTERVAL         ((HR_SAMPLE_RATE_HZ * 60) / 200)
+#define HR_MAX_INTERVAL         ((HR_SAMPLE_RATE_HZ * 60) / 30)
+
+#define HR_MIN_BEATS            3
+
+void hr_reset(struct hr_detector *hr)
+{
+    memset(hr, 0, sizeof(*hr));
+}
+
+static void hr_interval_add(struct hr_detector *hr, uint16_t interval)
+{
+    if (hr->interval_cnt == HR_INTERVALS)
+    {
+        hr->interval_sum -= hr->intervals[hr->interval_idx];
+    }
+    else
+    {
+        hr->interval_cnt++;
+    }
+
+    hr->intervals[hr->interval_idx] = interval;
+    hr->interval_sum += interval;
+    hr->interval_idx = (hr->interval_idx + 1) % HR_INTERVALS;
+}
+
+void hr_sample_add(struct hr_detector *hr, uint32_t ir)
+{
+    int32_t ac;
+
+    if (hr->sample_cnt == 0)
+    {
+        hr->dc_q8 = (int32_t)(ir << 8);
+    }
+
+    hr->sample_cnt++;
+
+    /* Blood volume increases absorption, so the pulse is a dip in IR */
+    hr->dc_q8 += (int32_t)((ir << 8) - hr->dc_q8) >> HR_DC_SHIFT;
+    ac = (hr->dc_q8 >> 8) - (int32_t)ir;
+
+    hr->prev_lp = hr->lp;
+    hr->lp += (ac - hr->lp) >> HR_LP_SHIFT;
+
+    hr->envelope -= hr->envelope >> HR_ENVELOPE_SHIFT;
+    hr->envelope = MAX(hr->envelope, hr->lp);
+
+    if (hr->lp > hr->prev_lp)
+    {
+        hr->rising = true;
+        return;
+    }
+
+    /* A maximum above 3/4 of the envelope is a beat */
+    if (hr->rising && (hr->prev_lp > ((hr->envelope * 3) / 4)))
+    {
+        uint32_t interval = hr->sample_cnt - 1 - hr->last_peak;
+        uint32_t refractory = HR_MIN_INTERVAL;
+
+        /* Once the rhythm is known, ignore peaks earlier than 60 % of it */
+        if (hr->interval_cnt >= HR_MIN_BEATS)
+        {
+            refractory = MAX(refractory, (hr->interval_sum * 3) / (hr->interval_cnt * 5));
+        }
+
+        if (interval < refractory)
+        {
+            /* Dicrotic notch or noise within the refractory period */
+            hr->rising = false;
+            return;
+        }
+
+        if ((hr->last_peak != 0) && (interval <= HR_MAX_INTERVAL))
+        {
+            hr_interval_add(hr, interval);
+        }
+
+        hr->last_peak = hr->sample_cnt - 1;
+    }
+
+    hr->rising = false;
+}
+
+uint8_t hr_bpm_get(const struct hr_detector *hr)
+{
+    if (hr->interval_cnt < HR_MIN_BEATS)
+    {
+        return 0;
+    }
+
+    return (uint8_t)((HR_SAMPLE_RATE_HZ * 60 * hr->interval_cnt) / hr->interval_sum);
+}
@@ -0,0 +1,37 @@
+#ifndef HR_H
+#define HR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define HR_INTERVALS    8
+
+/*
+ * Streaming heart rate detector working on the IR PPG samples. Every
+ * sample is band-passed (DC tracker and single pole low-pass) and fed
+ * to a peak detector with an adaptive threshold. The rate is the mean
+ * of the last HR_INTERVALS beat to beat intervals.
+ */
+struct hr_detector
+{
+    uint32_t sample_cnt;
+    uint32_t last_peak;
+    int32_t dc_q8;
+    int32_t lp;
+    int32_t prev_lp;
+    int32_t envelope;
+    uint16_t intervals[HR_INTERVALS];
+    uint8_t interval_idx;
+    uint8_t interval_cnt;
+    uint32_t interval_sum;
+    bool rising;
+};
+
+void hr_reset(struct hr_detector *hr);
+
+void hr_sample_add(struct hr_detector *hr, uint32_t ir);
+
+/* Heart rate in beats per minute, 0 until enough beats were detected */
+uint8_t hr_bpm_get(const struct hr_detector *hr);
+
+#endif /* HR_H */
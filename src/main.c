@@ -3,23 +3,43 @@
 #include <zephyr/logging/log.h>
 LOG_MODULE_REGISTER(main, CONFIG_LOG_DEFAULT_LEVEL);
 
+#include "sched.h"
 #include "display.h"
 #include "button.h"
 #include "spo2.h"
 #include "co2.h"
+#include "mem_stats.h"
+#include "recorder.h"
+#include "stream.h"
+#include "power.h"
 
 void main(void)
 {
     LOG_INF("App start");
 
     button_cb_t buttons_cb[BUTTON_TOP] = {spo2_button_pressed, co2_button_pressed};
+    sched_init();
+#ifdef CONFIG_APP_RECORDING
+    recorder_init();
+#endif
+#ifdef CONFIG_APP_STREAM
+    stream_init();
+#endif
     display_init();
-    button_init(buttons_cb);
     spo2_init();
     co2_init();
 
-    while(1)
-    {
-        k_sleep(K_SECONDS(1));
-    }
+#ifdef CONFIG_APP_POWER
+    /* The sensors above still need their bus to initialize */
+    power_init();
+#endif
+
+    /* No measurement can start before everything is set up */
+    button_init(buttons_cb);
+
+#ifdef CONFIG_APP_MEM_STATS
+    mem_stats_init();
+#endif
+
+    /* Everything runs in the work queues and threads, main has nothing left to wake up for */
 }
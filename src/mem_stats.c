@@ -0,0 +1,83 @@
+#include <zephyr/kernel.h>
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(mem_stats, CONFIG_APP_MEM_STATS_LOG_LEVEL);
+
+#include "sample_block.h"
+#include "sched.h"
+#include "mem_stats.h"
+
+/* A stack used beyond this share of its size is reported as a warning */
+#define MEM_STATS_STACK_WARN_PCT    90
+
+struct mem_stats_totals
+{
+    size_t stack_size;
+    size_t stack_used;
+};
+
+struct mem_stats_ctx
+{
+    struct k_work_delayable report;
+};
+
+static struct mem_stats_ctx mem_stats;
+
+/*
+ * The stacks are painted on creation, so the unused part is the span of
+ * the paint left intact. Scanning it is linear in the stack size.
+ */
+static void mem_stats_thread_cb(const struct k_thread *thread, void *user_data)
+{
+    struct mem_stats_totals *totals = user_data;
+    const char *name = k_thread_name_get((k_tid_t)thread);
+    size_t size = thread->stack_info.size;
+    size_t unused;
+    size_t used;
+
+    if (k_thread_stack_space_get(thread, &unused) < 0)
+    {
+        return;
+    }
+
+    used = size - unused;
+    totals->stack_size += size;
+    totals->stack_used += used;
+
+    if ((used * 100) >= (size * MEM_STATS_STACK_WARN_PCT))
+    {
+        LOG_WRN("Stack %s: %u of %u bytes used", name ? name : "?", (uint32_t)used, (uint32_t)size);
+    }
+    else
+    {
+        LOG_INF("Stack %s: %u of %u bytes used", name ? name : "?", (uint32_t)used, (uint32_t)size);
+    }
+}
+
+void mem_stats_report(void)
+{
+    struct mem_stats_totals totals = {0};
+    struct sample_block_stats blocks;
+
+    sample_block_stats_get(&blocks);
+
+    LOG_INF("Sample blocks: %u of %u in use, peak %u, %u allocation failures, %u bytes",
+        blocks.used, blocks.blocks, blocks.peak, blocks.failures, blocks.blocks * blocks.block_size);
+
+    /* The unlocked walk lets the callback log, threads must not exit meanwhile */
+    k_thread_foreach_unlocked(mem_stats_thread_cb, &totals);
+
+    LOG_INF("Stacks: %u of %u bytes used", (uint32_t)totals.stack_used, (uint32_t)totals.stack_size);
+}
+
+static void mem_stats_report_workqueue(struct k_work *item)
+{
+    mem_stats_report();
+    sched_reschedule(SCHED_DSP, &mem_stats.report, K_SECONDS(CONFIG_APP_MEM_STATS_PERIOD_S));
+}
+
+void mem_stats_init(void)
+{
+    k_work_init_delayable(&mem_stats.report, mem_stats_report_workqueue);
+    sched_reschedule(SCHED_DSP, &mem_stats.report, K_SECONDS(CONFIG_APP_MEM_STATS_PERIOD_S));
+}
@@ -0,0 +1,13 @@
+#ifndef MEM_STATS_H
+#define MEM_STATS_H
+
+/*
+ * Periodic RAM budget report: the sample block pool usage and the stack
+ * high-water mark of every thread, so the buffers and stacks can be
+ * sized from measurements instead of guesses.
+ */
+void mem_stats_init(void);
+
+void mem_stats_report(void);
+
+#endif /* MEM_STATS_H */
@@ -0,0 +1,211 @@
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/device.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/pm/device.h>
+#include <zephyr/pm/device_runtime.h>
+#include <zephyr/sys/poweroff.h>
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(power, CONFIG_APP_POWER_LOG_LEVEL);
+
+#include "button.h"
+#include "display.h"
+#include "sched.h"
+#include "power.h"
+
+#define POWER_SENSOR_BUS_NODE    DT_BUS(DT_COMPAT_GET_ANY_STATUS_OKAY(maxim_max30102))
+
+BUILD_ASSERT(DT_SAME_NODE(POWER_SENSOR_BUS_NODE, DT_BUS(DT_COMPAT_GET_ANY_STATUS_OKAY(sensirion_stc31))),
+    "Both sensors are expected on the same bus");
+
+struct power_ctx
+{
+    const struct device *bus;
+    struct k_mutex lock;
+    enum power_state state;
+    uint8_t measurements;
+    int64_t state_since;
+    int64_t time_ms[POWER_STATE_TOP];
+    struct k_work_delayable standby_work;
+#ifdef CONFIG_APP_POWER_OFF
+    struct k_work_delayable off_work;
+#endif
+};
+
+static struct power_ctx power;
+
+static const char *const power_state_names[POWER_STATE_TOP] =
+{
+    [POWER_ACTIVE] = "active",
+    [POWER_IDLE] = "idle",
+    [POWER_STANDBY] = "standby",
+};
+
+/* Called with the lock held */
+static void power_state_set(enum power_state state)
+{
+    int64_t now = k_uptime_get();
+
+    power.time_ms[power.state] += now - power.state_since;
+    power.state_since = now;
+
+    if (state != power.state)
+    {
+        LOG_DBG("%s -> %s", power_state_names[power.state], power_state_names[state]);
+        power.state = state;
+    }
+}
+
+static void power_report(void)
+{
+    int64_t time_ms[POWER_STATE_TOP];
+
+    power_stats_get(time_ms);
+
+#ifdef CONFIG_APP_POWER_STATS
+    k_thread_runtime_stats_t stats;
+
+    if ((k_thread_runtime_stats_all_get(&stats) == 0) && (stats.execution_cycles != 0))
+    {
+        LOG_INF("Power: active %u s, idle %u s, standby %u s, CPU idle %u %%",
+            (uint32_t)(time_ms[POWER_ACTIVE] / MSEC_PER_SEC), (uint32_t)(time_ms[POWER_IDLE] / MSEC_PER_SEC),
+            (uint32_t)(time_ms[POWER_STANDBY] / MSEC_PER_SEC),
+            (uint32_t)((stats.idle_cycles * 100) / stats.execution_cycles));
+        return;
+    }
+#endif
+
+    LOG_INF("Power: active %u s, idle %u s, standby %u s",
+        (uint32_t)(time_ms[POWER_ACTIVE] / MSEC_PER_SEC), (uint32_t)(time_ms[POWER_IDLE] / MSEC_PER_SEC),
+        (uint32_t)(time_ms[POWER_STANDBY] / MSEC_PER_SEC));
+}
+
+#ifdef CONFIG_APP_POWER_OFF
+static void power_off_workqueue(struct k_work *item)
+{
+    k_mutex_lock(&power.lock, K_FOREVER);
+
+    /* A measurement started meanwhile */
+    if (power.state != POWER_STANDBY)
+    {
+        k_mutex_unlock(&power.lock);
+        return;
+    }
+
+    power_report();
+    LOG_INF("System OFF, press a button to wake up");
+
+    button_wakeup_enable();
+
+    /* The log is deferred, flush it before the RAM is lost */
+    LOG_PANIC();
+    sys_poweroff();
+}
+#endif
+
+static void power_standby_workqueue(struct k_work *item)
+{
+    k_mutex_lock(&power.lock, K_FOREVER);
+
+    if ((power.measurements == 0) && (power.state == POWER_IDLE))
+    {
+        display_power_set(false);
+        power_state_set(POWER_STANDBY);
+        power_report();
+#ifdef CONFIG_APP_POWER_OFF
+        sched_reschedule(SCHED_ACQ, &power.off_work, K_SECONDS(CONFIG_APP_POWER_OFF_TIMEOUT_S));
+#endif
+    }
+
+    k_mutex_unlock(&power.lock);
+}
+
+void power_measurement_start(const struct device *dev)
+{
+    k_mutex_lock(&power.lock, K_FOREVER);
+
+    if ((power.bus != NULL) && (pm_device_runtime_get(power.bus) < 0))
+    {
+        LOG_ERR("Could not resume the sensor bus\n");
+    }
+
+    /* The sensor resumes once its bus is up, a driver without runtime PM ignores it */
+    if (pm_device_runtime_get(dev) < 0)
+    {
+        LOG_ERR("Could not resume %s\n", dev->name);
+    }
+
+    k_work_cancel_delayable(&power.standby_work);
+#ifdef CONFIG_APP_POWER_OFF
+    k_work_cancel_delayable(&power.off_work);
+#endif
+
+    if (power.state == POWER_STANDBY)
+    {
+        display_power_set(true);
+    }
+
+    power.measurements++;
+    power_state_set(POWER_ACTIVE);
+
+    k_mutex_unlock(&power.lock);
+}
+
+void power_measurement_stop(const struct device *dev)
+{
+    k_mutex_lock(&power.lock, K_FOREVER);
+
+    if (pm_device_runtime_put(dev) < 0)
+    {
+        LOG_ERR("Could not suspend %s\n", dev->name);
+    }
+
+    if ((power.bus != NULL) && (pm_device_runtime_put(power.bus) < 0))
+    {
+        LOG_ERR("Could not suspend the sensor bus\n");
+    }
+
+    if ((power.measurements > 0) && (--power.measurements == 0))
+    {
+        power_state_set(POWER_IDLE);
+        sched_reschedule(SCHED_ACQ, &power.standby_work, K_SECONDS(CONFIG_APP_POWER_STANDBY_TIMEOUT_S));
+    }
+
+    k_mutex_unlock(&power.lock);
+}
+
+void power_stats_get(int64_t time_ms[POWER_STATE_TOP])
+{
+    k_mutex_lock(&power.lock, K_FOREVER);
+
+    power_state_set(power.state);
+    memcpy(time_ms, power.time_ms, sizeof(power.time_ms));
+
+    k_mutex_unlock(&power.lock);
+}
+
+void power_init(void)
+{
+    k_mutex_init(&power.lock);
+    k_work_init_delayable(&power.standby_work, power_standby_workqueue);
+#ifdef CONFIG_APP_POWER_OFF
+    k_work_init_delayable(&power.off_work, power_off_workqueue);
+#endif
+
+    power.state = POWER_IDLE;
+    power.state_since = k_uptime_get();
+
+    /*
+     * From now on the bus is suspended whenever no measurement holds it.
+     * Emulated buses do not support PM, they simply stay resumed.
+     */
+    power.bus = DEVICE_DT_GET(POWER_SENSOR_BUS_NODE);
+    if (pm_device_runtime_enable(power.bus) < 0)
+    {
+        LOG_INF("No runtime PM on %s, it stays resumed", power.bus->name);
+        power.bus = NULL;
+    }
+
+    sched_reschedule(SCHED_ACQ, &power.standby_work, K_SECONDS(CONFIG_APP_POWER_STANDBY_TIMEOUT_S));
+}
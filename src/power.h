@@ -0,0 +1,40 @@
+#ifndef POWER_H
+#define POWER_H
+
+#include <zephyr/device.h>
+
+enum power_state
+{
+    /* At least one measurement is running */
+    POWER_ACTIVE,
+    /* Nothing is measured, the display shows the last readings */
+    POWER_IDLE,
+    /* The display and the sensor bus are suspended */
+    POWER_STANDBY,
+
+    POWER_STATE_TOP,
+};
+
+/*
+ * Power manager. The sensor bus is only resumed while a measurement
+ * holds it, the display is suspended after APP_POWER_STANDBY_TIMEOUT_S
+ * without measurement and, with APP_POWER_OFF, the system goes to
+ * System OFF after APP_POWER_OFF_TIMEOUT_S more, to be woken up by the
+ * buttons. Call power_init() once the sensors are initialized, as it
+ * suspends their bus.
+ */
+void power_init(void);
+
+/*
+ * Hold the sensor bus and the sensor for the duration of a measurement
+ * and leave the standby. Thread context only, the calls may block while
+ * the devices resume.
+ */
+void power_measurement_start(const struct device *dev);
+
+void power_measurement_stop(const struct device *dev);
+
+/* Time spent in each state since boot */
+void power_stats_get(int64_t time_ms[POWER_STATE_TOP]);
+
+#endif /* POWER_H */
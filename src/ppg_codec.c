@@ -0,0 +1,199 @@
+#include <errno.h>
+
+#include <zephyr/sys/util.h>
+
+#include "ppg_codec.h"
+
+#define PPG_CODEC_SAMPLE_MASK    BIT_MASK(PPG_CODEC_SAMPLE_BITS)
+#define PPG_CODEC_HEADER_SIZE    (3 + (2 * 3))
+
+struct ppg_codec_bits
+{
+    uint8_t *buf;
+    const uint8_t *rd;
+    size_t len;
+    size_t size;
+    uint32_t acc;
+    uint8_t cnt;
+};
+
+static uint32_t ppg_codec_zigzag(int32_t delta)
+{
+    return ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+}
+
+static int32_t ppg_codec_unzigzag(uint32_t val)
+{
+    return (int32_t)(val >> 1) ^ -(int32_t)(val & 1);
+}
+
+static uint8_t ppg_codec_width(const uint32_t *samples, uint8_t count)
+{
+    uint32_t all = 0;
+
+    for (uint8_t i = 1; i < count; i++)
+    {
+        int32_t delta = (int32_t)(samples[i] & PPG_CODEC_SAMPLE_MASK) -
+            (int32_t)(samples[i - 1] & PPG_CODEC_SAMPLE_MASK);
+
+        all |= ppg_codec_zigzag(delta);
+    }
+
+    /* The highest bit set over all the deltas gives the common width */
+    return (all == 0) ? 0 : (32 - __builtin_clz(all));
+}
+
+static void ppg_codec_put24(uint8_t *buf, uint32_t val)
+{
+    buf[0] = (uint8_t)val;
+    buf[1] = (uint8_t)(val >> 8);
+    buf[2] = (uint8_t)(val >> 16);
+}
+
+static uint32_t ppg_codec_get24(const uint8_t *buf)
+{
+    return (buf[0] | (buf[1] << 8) | ((uint32_t)buf[2] << 16)) & PPG_CODEC_SAMPLE_MASK;
+}
+
+/* Widths are at most 19 bits, so the accumulator never holds more than 26 */
+static void ppg_codec_bits_put(struct ppg_codec_bits *bits, uint32_t val, uint8_t width)
+{
+    bits->acc |= val << bits->cnt;
+    bits->cnt += width;
+
+    while (bits->cnt >= 8)
+    {
+        bits->buf[bits->len++] = (uint8_t)bits->acc;
+        bits->acc >>= 8;
+        bits->cnt -= 8;
+    }
+}
+
+static int ppg_codec_bits_get(struct ppg_codec_bits *bits, uint8_t width, uint32_t *val)
+{
+    while (bits->cnt < width)
+    {
+        if (bits->len >= bits->size)
+        {
+            return -EINVAL;
+        }
+
+        bits->acc |= (uint32_t)bits->rd[bits->len++] << bits->cnt;
+        bits->cnt += 8;
+    }
+
+    *val = bits->acc & BIT_MASK(width);
+    bits->acc >>= width;
+    bits->cnt -= width;
+
+    return 0;
+}
+
+static void ppg_codec_deltas_put(struct ppg_codec_bits *bits, const uint32_t *samples, uint8_t count,
+    uint8_t width)
+{
+    for (uint8_t i = 1; i < count; i++)
+    {
+        int32_t delta = (int32_t)(samples[i] & PPG_CODEC_SAMPLE_MASK) -
+            (int32_t)(samples[i - 1] & PPG_CODEC_SAMPLE_MASK);
+
+        ppg_codec_bits_put(bits, ppg_codec_zigzag(delta), width);
+    }
+}
+
+static int ppg_codec_deltas_get(struct ppg_codec_bits *bits, uint32_t *samples, uint8_t count,
+    uint8_t width)
+{
+    for (uint8_t i = 1; i < count; i++)
+    {
+        uint32_t val;
+
+        if (ppg_codec_bits_get(bits, width, &val) < 0)
+        {
+            return -EINVAL;
+        }
+
+        samples[i] = (uint32_t)((int32_t)samples[i - 1] + ppg_codec_unzigzag(val)) & PPG_CODEC_SAMPLE_MASK;
+    }
+
+    return 0;
+}
+
+int ppg_codec_encode(const uint32_t *red, const uint32_t *ir, uint8_t count, uint8_t *buf, size_t size)
+{
+    struct ppg_codec_bits bits = {.buf = buf, .len = PPG_CODEC_HEADER_SIZE};
+    uint8_t red_width;
+    uint8_t ir_width;
+    size_t len;
+
+    if (count == 0)
+    {
+        if (size < 1)
+        {
+            return -ENOMEM;
+        }
+
+        buf[0] = 0;
+        return 1;
+    }
+
+    red_width = ppg_codec_width(red, count);
+    ir_width = ppg_codec_width(ir, count);
+    len = PPG_CODEC_HEADER_SIZE + (((count - 1) * (red_width + ir_width)) + 7) / 8;
+
+    if (size < len)
+    {
+        return -ENOMEM;
+    }
+
+    buf[0] = count;
+    buf[1] = red_width;
+    buf[2] = ir_width;
+    ppg_codec_put24(&buf[3], red[0]);
+    ppg_codec_put24(&buf[6], ir[0]);
+
+    ppg_codec_deltas_put(&bits, red, count, red_width);
+    ppg_codec_deltas_put(&bits, ir, count, ir_width);
+
+    /* Flush the last partial byte */
+    if (bits.cnt != 0)
+    {
+        buf[bits.len++] = (uint8_t)bits.acc;
+    }
+
+    return (int)bits.len;
+}
+
+int ppg_codec_decode(const uint8_t *buf, size_t len, uint32_t *red, uint32_t *ir, uint8_t max)
+{
+    struct ppg_codec_bits bits = {.rd = buf, .len = PPG_CODEC_HEADER_SIZE, .size = len};
+    uint8_t count;
+
+    if (len < 1)
+    {
+        return -EINVAL;
+    }
+
+    count = buf[0];
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    if ((count > max) || (len < PPG_CODEC_HEADER_SIZE) ||
+        (buf[1] > (PPG_CODEC_SAMPLE_BITS + 1)) || (buf[2] > (PPG_CODEC_SAMPLE_BITS + 1)))
+    {
+        return -EINVAL;
+    }
+
+    red[0] = ppg_codec_get24(&buf[3]);
+    ir[0] = ppg_codec_get24(&buf[6]);
+
+    if ((ppg_codec_deltas_get(&bits, red, count, buf[1]) < 0) ||
+        (ppg_codec_deltas_get(&bits, ir, count, buf[2]) < 0))
+    {
+        return -EINVAL;
+    }
+
+    return count;
+}
@@ -0,0 +1,524 @@
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/fs/fcb.h>
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/zbus/zbus.h>
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(recorder, CONFIG_LOG_DEFAULT_LEVEL);
+
+#include "channels.h"
+#include "ppg_codec.h"
+#include "sample_block.h"
+#include "sched.h"
+#include "recorder.h"
+
+#define RECORDER_PARTITION_ID          FIXED_PARTITION_ID(storage_partition)
+#define RECORDER_MAGIC                 0x52454331
+#define RECORDER_VERSION               1
+#define RECORDER_MAX_SECTORS           32
+
+/* Room for the FCB sector header, the entry length and CRC, and alignment */
+#define RECORDER_SECTOR_OVERHEAD       32
+
+/* A sample block is queued every 280 ms, the rest comes at most at 10 Hz */
+#define RECORDER_QUEUE_SIZE            8
+
+#define RECORDER_BATCH_HEADER_SIZE     4
+#define RECORDER_RECORD_HEADER_SIZE    6
+#define RECORDER_PPG_HEADER_SIZE       2
+#define RECORDER_PAYLOAD_MAX_SIZE      (RECORDER_PPG_HEADER_SIZE + PPG_CODEC_MAX_SIZE(SAMPLE_BLOCK_SIZE))
+
+BUILD_ASSERT(RECORDER_PAYLOAD_MAX_SIZE <= UINT8_MAX, "The record length is a single byte");
+BUILD_ASSERT(CONFIG_APP_RECORDING_BATCH_SIZE >=
+    (RECORDER_BATCH_HEADER_SIZE + RECORDER_RECORD_HEADER_SIZE + RECORDER_PAYLOAD_MAX_SIZE),
+    "A batch must hold the largest record");
+
+struct recorder_msg
+{
+    uint8_t type;
+    uint32_t time_ms;
+    union
+    {
+        struct sample_block *block;
+        struct spo2_msg spo2;
+        struct co2_raw_msg co2;
+        struct etco2_msg etco2;
+    };
+};
+
+struct recorder_walk
+{
+    struct recorder_summary summary;
+    bool found;
+    uint32_t skipped;
+    recorder_session_cb_t cb;
+    void *user_data;
+};
+
+K_MSGQ_DEFINE(recorder_msgq, sizeof(struct recorder_msg), RECORDER_QUEUE_SIZE, 4);
+
+struct recorder_ctx
+{
+    struct fcb fcb;
+    struct flash_sector sectors[RECORDER_MAX_SECTORS];
+    uint8_t batch[CONFIG_APP_RECORDING_BATCH_SIZE];
+    uint16_t capacity;
+    uint16_t len;
+    bool ready;
+    atomic_t dropped;
+    struct k_work drain;
+    struct k_work_delayable flush;
+    struct recorder_summary summary;
+    uint32_t write_us_max;
+};
+
+static struct recorder_ctx recorder;
+
+static void recorder_summary_log(const struct recorder_summary *summary)
+{
+    LOG_INF("Session %u: %u entries, %u bytes, %u SpO2, %u CO2, %u breaths, "
+            "%u PPG samples packed in %u bytes, %u errors",
+        summary->session, summary->entries, summary->bytes, summary->records[RECORDER_SPO2],
+        summary->records[RECORDER_CO2], summary->records[RECORDER_ETCO2], summary->ppg_samples,
+        summary->ppg_bytes, summary->errors);
+}
+
+/* Decode every record of a stored batch, so a summary also proves the data reads back */
+static void recorder_batch_parse(const uint8_t *buf, uint16_t len, struct recorder_summary *summary)
+{
+    uint16_t off = RECORDER_BATCH_HEADER_SIZE;
+
+    while ((off + RECORDER_RECORD_HEADER_SIZE) <= len)
+    {
+        uint8_t type = buf[off];
+        uint8_t payload_len = buf[off + 1];
+        const uint8_t *payload = &buf[off + RECORDER_RECORD_HEADER_SIZE];
+
+        if (type == RECORDER_END)
+        {
+            return;
+        }
+
+        if ((type >= RECORDER_TOP) || ((off + RECORDER_RECORD_HEADER_SIZE + payload_len) > len))
+        {
+            summary->errors++;
+            return;
+        }
+
+        if (type == RECORDER_PPG)
+        {
+            uint32_t red[SAMPLE_BLOCK_SIZE];
+            uint32_t ir[SAMPLE_BLOCK_SIZE];
+            int count = -EINVAL;
+
+            if (payload_len >= RECORDER_PPG_HEADER_SIZE)
+            {
+                count = ppg_codec_decode(&payload[RECORDER_PPG_HEADER_SIZE],
+                    payload_len - RECORDER_PPG_HEADER_SIZE, red, ir, SAMPLE_BLOCK_SIZE);
+            }
+
+            if (count < 0)
+            {
+                summary->errors++;
+            }
+            else
+            {
+                summary->ppg_samples += count;
+                summary->ppg_bytes += payload_len - RECORDER_PPG_HEADER_SIZE;
+            }
+        }
+
+        summary->records[type]++;
+        off += RECORDER_RECORD_HEADER_SIZE + payload_len;
+    }
+}
+
+/* The entries come from the oldest to the newest, so do the sessions */
+static int recorder_walk_cb(struct fcb_entry_ctx *loc_ctx, void *arg)
+{
+    struct recorder_walk *walk = arg;
+    uint16_t len = loc_ctx->loc.fe_data_len;
+    uint16_t session;
+
+    if ((len < RECORDER_BATCH_HEADER_SIZE) || (len > sizeof(recorder.batch)) ||
+        (flash_area_read(loc_ctx->fap, FCB_ENTRY_FA_DATA_OFF(loc_ctx->loc), recorder.batch, len) < 0) ||
+        (recorder.batch[0] != RECORDER_VERSION))
+    {
+        walk->skipped++;
+        return 0;
+    }
+
+    session = sys_get_le16(&recorder.batch[2]);
+
+    if (walk->found && (session != walk->summary.session))
+    {
+        walk->cb(&walk->summary, walk->user_data);
+        memset(&walk->summary, 0, sizeof(walk->summary));
+    }
+
+    walk->found = true;
+    walk->summary.session = session;
+    walk->summary.entries++;
+    walk->summary.bytes += len;
+    recorder_batch_parse(recorder.batch, len, &walk->summary);
+
+    return 0;
+}
+
+static int recorder_fcb_init(uint32_t sector_cnt)
+{
+    memset(&recorder.fcb, 0, sizeof(recorder.fcb));
+    recorder.fcb.f_magic = RECORDER_MAGIC;
+    recorder.fcb.f_version = RECORDER_VERSION;
+    recorder.fcb.f_sector_cnt = (uint8_t)sector_cnt;
+    recorder.fcb.f_sectors = recorder.sectors;
+
+    return fcb_init(RECORDER_PARTITION_ID, &recorder.fcb);
+}
+
+static int recorder_erase(void)
+{
+    const struct flash_area *fa;
+    int err;
+
+    err = flash_area_open(RECORDER_PARTITION_ID, &fa);
+    if (err < 0)
+    {
+        return err;
+    }
+
+    err = flash_area_erase(fa, 0, fa->fa_size);
+    flash_area_close(fa);
+
+    return err;
+}
+
+static void recorder_batch_reset(void)
+{
+    recorder.batch[0] = RECORDER_VERSION;
+    recorder.batch[1] = 0;
+    sys_put_le16(recorder.summary.session, &recorder.batch[2]);
+    recorder.len = RECORDER_BATCH_HEADER_SIZE;
+}
+
+/*
+ * One flash write per batch. When the partition is full the oldest
+ * sector is erased first, which stalls the work queue for the erase
+ * time; the listeners keep queuing meanwhile.
+ */
+static void recorder_batch_write(void)
+{
+    uint16_t len = ROUND_UP(recorder.len, MAX(recorder.fcb.f_align, 1));
+    uint32_t start = k_cycle_get_32();
+    struct fcb_entry loc;
+    int err;
+
+    if (recorder.len <= RECORDER_BATCH_HEADER_SIZE)
+    {
+        return;
+    }
+
+    /* Pad to the write block, a record type of 0 ends the batch */
+    memset(&recorder.batch[recorder.len], RECORDER_END, len - recorder.len);
+
+    err = fcb_append(&recorder.fcb, len, &loc);
+    if (err == -ENOSPC)
+    {
+        err = fcb_rotate(&recorder.fcb);
+        if (err == 0)
+        {
+            err = fcb_append(&recorder.fcb, len, &loc);
+        }
+    }
+
+    if (err == 0)
+    {
+        err = flash_area_write(recorder.fcb.fap, FCB_ENTRY_FA_DATA_OFF(loc), recorder.batch, len);
+    }
+
+    if (err == 0)
+    {
+        err = fcb_append_finish(&recorder.fcb, &loc);
+    }
+
+    if (err < 0)
+    {
+        LOG_ERR("Could not write the batch (%d)\n", err);
+    }
+    else
+    {
+        recorder.summary.entries++;
+        recorder.summary.bytes += len;
+        recorder.write_us_max = MAX(recorder.write_us_max, k_cyc_to_us_near32(k_cycle_get_32() - start));
+    }
+
+    recorder_batch_reset();
+}
+
+static void recorder_record_add(uint8_t type, uint32_t time_ms, const uint8_t *payload, uint8_t len)
+{
+    uint8_t *record;
+
+    if ((recorder.len + RECORDER_RECORD_HEADER_SIZE + len) > recorder.capacity)
+    {
+        recorder_batch_write();
+    }
+
+    record = &recorder.batch[recorder.len];
+    record[0] = type;
+    record[1] = len;
+    sys_put_le32(time_ms, &record[2]);
+    memcpy(&record[RECORDER_RECORD_HEADER_SIZE], payload, len);
+
+    recorder.len += RECORDER_RECORD_HEADER_SIZE + len;
+    recorder.summary.records[type]++;
+}
+
+static void recorder_msg_record(const struct recorder_msg *msg)
+{
+    uint8_t payload[RECORDER_PAYLOAD_MAX_SIZE];
+    int len;
+
+    switch (msg->type)
+    {
+        case RECORDER_SPO2:
+            payload[0] = msg->spo2.spo2;
+            payload[1] = msg->spo2.hr;
+            len = 2;
+            break;
+        case RECORDER_CO2:
+            sys_put_le16(msg->co2.co2, payload);
+            len = 2;
+            break;
+        case RECORDER_ETCO2:
+            sys_put_le16(msg->etco2.etco2, payload);
+            payload[2] = msg->etco2.rr;
+            len = 3;
+            break;
+        case RECORDER_PPG:
+            sys_put_le16((uint16_t)msg->block->seq, payload);
+            len = ppg_codec_encode(msg->block->red, msg->block->ir, (uint8_t)msg->block->count,
+                &payload[RECORDER_PPG_HEADER_SIZE], sizeof(payload) - RECORDER_PPG_HEADER_SIZE);
+            if (len >= 0)
+            {
+                recorder.summary.ppg_samples += msg->block->count;
+                recorder.summary.ppg_bytes += len;
+                len += RECORDER_PPG_HEADER_SIZE;
+            }
+            sample_block_unref(msg->block);
+            break;
+
+        default:
+            return;
+    }
+
+    if (len < 0)
+    {
+        recorder.summary.errors++;
+        return;
+    }
+
+    recorder_record_add(msg->type, msg->time_ms, payload, (uint8_t)len);
+}
+
+static void recorder_drain_workqueue(struct k_work *item)
+{
+    struct recorder_msg msg;
+
+    while (k_msgq_get(&recorder_msgq, &msg, K_NO_WAIT) == 0)
+    {
+        recorder_msg_record(&msg);
+    }
+
+    /* A partial batch is written once the data stops */
+    sched_reschedule(SCHED_DSP, &recorder.flush, K_SECONDS(CONFIG_APP_RECORDING_FLUSH_S));
+}
+
+static void recorder_init_session_cb(const struct recorder_summary *summary, void *user_data)
+{
+    int32_t *last = user_data;
+
+    recorder_summary_log(summary);
+    *last = summary->session;
+}
+
+static void recorder_flush_workqueue(struct k_work *item)
+{
+    recorder_batch_write();
+
+    LOG_INF("Recorded %u entries, %u bytes, %u PPG samples in %u bytes, %u dropped, write max %u us",
+        recorder.summary.entries, recorder.summary.bytes, recorder.summary.ppg_samples,
+        recorder.summary.ppg_bytes, (uint32_t)atomic_get(&recorder.dropped), recorder.write_us_max);
+}
+
+/* Runs in the publisher context, the flash is only touched by the DSP work queue */
+static void recorder_chan_cb(const struct zbus_channel *chan)
+{
+    struct recorder_msg msg = {.time_ms = k_uptime_get_32()};
+
+    if (!recorder.ready)
+    {
+        return;
+    }
+
+    if (chan == &ppg_block_chan)
+    {
+        const struct ppg_block_msg *ppg = zbus_chan_const_msg(chan);
+
+        /* The block is encoded later, it is kept alive until then */
+        msg.type = RECORDER_PPG;
+        msg.block = ppg->block;
+        msg.time_ms = ppg->block->time_ms;
+        sample_block_ref(msg.block);
+    }
+    else if (chan == &spo2_chan)
+    {
+        msg.type = RECORDER_SPO2;
+        msg.spo2 = *(const struct spo2_msg *)zbus_chan_const_msg(chan);
+    }
+    else if (chan == &co2_raw_chan)
+    {
+        msg.type = RECORDER_CO2;
+        msg.co2 = *(const struct co2_raw_msg *)zbus_chan_const_msg(chan);
+        msg.time_ms = msg.co2.time_ms;
+    }
+    else if (chan == &etco2_chan)
+    {
+        msg.type = RECORDER_ETCO2;
+        msg.etco2 = *(const struct etco2_msg *)zbus_chan_const_msg(chan);
+    }
+    else
+    {
+        return;
+    }
+
+    if (k_msgq_put(&recorder_msgq, &msg, K_NO_WAIT) < 0)
+    {
+        if (msg.type == RECORDER_PPG)
+        {
+            sample_block_unref(msg.block);
+        }
+
+        atomic_inc(&recorder.dropped);
+        return;
+    }
+
+    sched_submit(SCHED_DSP, &recorder.drain);
+}
+
+ZBUS_LISTENER_DEFINE(recorder_lis, recorder_chan_cb);
+
+#ifdef CONFIG_APP_RECORDING_PPG
+ZBUS_CHAN_ADD_OBS(ppg_block_chan, recorder_lis, 1);
+#endif
+ZBUS_CHAN_ADD_OBS(spo2_chan, recorder_lis, 1);
+ZBUS_CHAN_ADD_OBS(co2_raw_chan, recorder_lis, 1);
+ZBUS_CHAN_ADD_OBS(etco2_chan, recorder_lis, 1);
+
+void recorder_flush(void)
+{
+    struct k_work_sync sync;
+
+    if (!recorder.ready)
+    {
+        return;
+    }
+
+    /* The drain reschedules the flush, so let it run first */
+    k_work_flush(&recorder.drain, &sync);
+    sched_reschedule(SCHED_DSP, &recorder.flush, K_NO_WAIT);
+    k_work_flush_delayable(&recorder.flush, &sync);
+}
+
+int recorder_sessions_walk(recorder_session_cb_t cb, void *user_data)
+{
+    struct recorder_walk walk = {.cb = cb, .user_data = user_data};
+    int err;
+
+    err = fcb_walk(&recorder.fcb, NULL, recorder_walk_cb, &walk);
+    if (err < 0)
+    {
+        return err;
+    }
+
+    if (walk.found)
+    {
+        cb(&walk.summary, user_data);
+    }
+
+    /* The entries were read into the batch buffer, which was empty */
+    recorder_batch_reset();
+
+    return (int)walk.skipped;
+}
+
+int recorder_init(void)
+{
+    uint32_t sector_cnt = ARRAY_SIZE(recorder.sectors);
+    int32_t last = -1;
+    int err;
+
+    err = flash_area_get_sectors(RECORDER_PARTITION_ID, &sector_cnt, recorder.sectors);
+    if (err < 0)
+    {
+        LOG_ERR("Could not get the storage sectors (%d)\n", err);
+        return err;
+    }
+
+    /* A full partition erases its oldest sector, so there must be another one */
+    if ((sector_cnt < 2) ||
+        (recorder.sectors[0].fs_size < (sizeof(recorder.batch) + RECORDER_SECTOR_OVERHEAD)))
+    {
+        LOG_ERR("The storage partition cannot hold batches of %u bytes\n",
+            (uint32_t)sizeof(recorder.batch));
+        return -EINVAL;
+    }
+
+    err = recorder_fcb_init(sector_cnt);
+    if (err < 0)
+    {
+        /* Foreign or corrupted content, start over from an empty partition */
+        LOG_WRN("Storage not recognized (%d), erasing it", err);
+
+        err = recorder_erase();
+        if (err == 0)
+        {
+            err = recorder_fcb_init(sector_cnt);
+        }
+
+        if (err < 0)
+        {
+            LOG_ERR("Could not initialize the storage (%d)\n", err);
+            return err;
+        }
+    }
+
+    recorder.ready = false;
+    memset(&recorder.summary, 0, sizeof(recorder.summary));
+
+    err = recorder_sessions_walk(recorder_init_session_cb, &last);
+    if (err < 0)
+    {
+        LOG_WRN("Could not read the stored sessions (%d)", err);
+    }
+    else if (err > 0)
+    {
+        LOG_WRN("%d stored entries could not be read", err);
+    }
+
+    recorder.summary.session = (uint16_t)(last + 1);
+    recorder.capacity = ROUND_DOWN(sizeof(recorder.batch), MAX(recorder.fcb.f_align, 1));
+    recorder_batch_reset();
+
+    k_work_init(&recorder.drain, recorder_drain_workqueue);
+    k_work_init_delayable(&recorder.flush, recorder_flush_workqueue);
+    recorder.ready = true;
+
+    LOG_INF("Recording session %u, %d of %u sectors free", recorder.summary.session,
+        fcb_free_sector_cnt(&recorder.fcb), sector_cnt);
+
+    return 0;
+}
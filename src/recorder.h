@@ -0,0 +1,66 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <stdint.h>
+
+/*
+ * Session recording to the storage partition. The channel listeners
+ * queue the readings and PPG blocks, the DSP work queue encodes them
+ * into a RAM batch and appends the batch to a flash circular buffer
+ * once full or once the data stops. The oldest sector is erased when
+ * the partition is full.
+ *
+ * A batch is one FCB entry: the format version, the reserved byte and
+ * the session number on 16 bits, then records of a type, a payload
+ * length and a timestamp in ms on 32 bits. A record type of 0 ends the
+ * batch, the rest is padding to the flash write block. All the fields
+ * are little endian.
+ */
+
+enum recorder_type
+{
+    RECORDER_END,
+    /* SpO2 in %, heart rate in bpm */
+    RECORDER_SPO2,
+    /* CO2 in 1/100 vol% on 16 bits */
+    RECORDER_CO2,
+    /* End-tidal CO2 in 1/100 vol% on 16 bits, respiratory rate */
+    RECORDER_ETCO2,
+    /* Block sequence number on 16 bits, then the ppg_codec block */
+    RECORDER_PPG,
+
+    RECORDER_TOP,
+};
+
+/* Session totals, as recorded or as read back from the flash */
+struct recorder_summary
+{
+    uint16_t session;
+    uint32_t entries;
+    uint32_t bytes;
+    uint32_t records[RECORDER_TOP];
+    uint32_t ppg_samples;
+    uint32_t ppg_bytes;
+    uint32_t errors;
+};
+
+typedef void (*recorder_session_cb_t)(const struct recorder_summary *summary, void *user_data);
+
+/* Mount the storage, log a summary of the stored sessions and start a new one */
+int recorder_init(void);
+
+/*
+ * Write the partial batch now, e.g. before powering off, and wait for
+ * the DSP work queue to finish it. Not callable from the DSP work queue.
+ */
+void recorder_flush(void);
+
+/*
+ * Read back every stored batch and report each session, from the oldest
+ * to the newest. Returns the number of entries which could not be read,
+ * or a negative error code. It reads into the batch buffer, so only call
+ * it right after recorder_flush() while no new data arrives.
+ */
+int recorder_sessions_walk(recorder_session_cb_t cb, void *user_data);
+
+#endif /* RECORDER_H */
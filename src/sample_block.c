@@ -0,0 +1,77 @@
+#include <zephyr/kernel.h>
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(sample_block, CONFIG_LOG_DEFAULT_LEVEL);
+
+#include "sample_block.h"
+
+K_MEM_SLAB_DEFINE_STATIC(sample_block_slab, sizeof(struct sample_block), CONFIG_APP_SAMPLE_BLOCKS, 4);
+
+struct sample_block_ctx
+{
+    atomic_t seq;
+    atomic_t peak;
+    atomic_t failures;
+};
+
+static struct sample_block_ctx sample_block;
+
+/* Blocks are freed from any context, so the peak is raised atomically */
+static void sample_block_peak_update(void)
+{
+    atomic_val_t used = (atomic_val_t)k_mem_slab_num_used_get(&sample_block_slab);
+    atomic_val_t peak;
+
+    do
+    {
+        peak = atomic_get(&sample_block.peak);
+        if (used <= peak)
+        {
+            return;
+        }
+    } while (!atomic_cas(&sample_block.peak, peak, used));
+}
+
+struct sample_block *sample_block_alloc(void)
+{
+    struct sample_block *block;
+
+    /* Never wait, the producers run on the sampling path */
+    if (k_mem_slab_alloc(&sample_block_slab, (void **)&block, K_NO_WAIT) < 0)
+    {
+        atomic_inc(&sample_block.failures);
+        return NULL;
+    }
+
+    sample_block_peak_update();
+
+    atomic_set(&block->refs, 1);
+    block->seq = (uint32_t)atomic_inc(&sample_block.seq);
+    block->time_ms = k_uptime_get_32();
+    block->count = 0;
+
+    return block;
+}
+
+void sample_block_ref(struct sample_block *block)
+{
+    atomic_inc(&block->refs);
+}
+
+void sample_block_unref(struct sample_block *block)
+{
+    /* atomic_dec() returns the previous value */
+    if (atomic_dec(&block->refs) == 1)
+    {
+        k_mem_slab_free(&sample_block_slab, block);
+    }
+}
+
+void sample_block_stats_get(struct sample_block_stats *stats)
+{
+    stats->blocks = CONFIG_APP_SAMPLE_BLOCKS;
+    stats->block_size = sizeof(struct sample_block);
+    stats->used = k_mem_slab_num_used_get(&sample_block_slab);
+    stats->peak = (uint32_t)atomic_get(&sample_block.peak);
+    stats->failures = (uint32_t)atomic_get(&sample_block.failures);
+}
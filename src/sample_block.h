@@ -0,0 +1,48 @@
+#ifndef SAMPLE_BLOCK_H
+#define SAMPLE_BLOCK_H
+
+#include <stdint.h>
+
+#include <zephyr/kernel.h>
+
+#include "max30102.h"
+
+/* One MAX30102 FIFO batch */
+#define SAMPLE_BLOCK_SIZE    MAX30102_FIFO_DEPTH
+
+/*
+ * Block of raw PPG samples from a fixed pool. Blocks travel by reference
+ * between the stages; a stage keeping a block beyond the call it got it
+ * in takes a reference, and the block returns to the pool once the last
+ * reference is dropped.
+ */
+struct sample_block
+{
+    atomic_t refs;
+    uint32_t seq;
+    uint32_t time_ms;
+    uint16_t count;
+    uint32_t red[SAMPLE_BLOCK_SIZE];
+    uint32_t ir[SAMPLE_BLOCK_SIZE];
+};
+
+struct sample_block_stats
+{
+    uint32_t blocks;
+    uint32_t block_size;
+    uint32_t used;
+    uint32_t peak;
+    uint32_t failures;
+};
+
+/* Returns a block holding one reference, NULL when the pool is empty */
+struct sample_block *sample_block_alloc(void);
+
+void sample_block_ref(struct sample_block *block);
+
+void sample_block_unref(struct sample_block *block);
+
+/* Pool usage since boot, the peak tells how many blocks are really needed */
+void sample_block_stats_get(struct sample_block_stats *stats);
+
+#endif /* SAMPLE_BLOCK_H */
@@ -0,0 +1,111 @@
+#include <zephyr/kernel.h>
+#include <string.h>
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(sched, CONFIG_APP_SCHED_LOG_LEVEL);
+
+#include "sched.h"
+
+K_THREAD_STACK_DEFINE(acq_stack, CONFIG_APP_ACQ_STACK_SIZE);
+K_THREAD_STACK_DEFINE(dsp_stack, CONFIG_APP_DSP_STACK_SIZE);
+
+struct sched_ctx
+{
+    struct k_work_q queue[SCHED_TOP];
+#ifdef CONFIG_APP_JITTER_STATS
+    struct sched_jitter_stats jitter;
+    uint32_t last_batch_cyc;
+#endif
+};
+
+static struct sched_ctx sched;
+
+void sched_init(void)
+{
+    struct k_work_queue_config acq_cfg = {.name = "acq_workq"};
+    struct k_work_queue_config dsp_cfg = {.name = "dsp_workq"};
+
+    k_work_queue_start(&sched.queue[SCHED_ACQ], acq_stack, K_THREAD_STACK_SIZEOF(acq_stack),
+        CONFIG_APP_ACQ_PRIORITY, &acq_cfg);
+    k_work_queue_start(&sched.queue[SCHED_DSP], dsp_stack, K_THREAD_STACK_SIZEOF(dsp_stack),
+        CONFIG_APP_DSP_PRIORITY, &dsp_cfg);
+}
+
+struct k_work_q *sched_queue_get(enum sched_queue queue)
+{
+    return (queue < SCHED_TOP) ? &sched.queue[queue] : NULL;
+}
+
+int sched_submit(enum sched_queue queue, struct k_work *work)
+{
+    if (queue >= SCHED_TOP)
+    {
+        return -EINVAL;
+    }
+
+    return k_work_submit_to_queue(&sched.queue[queue], work);
+}
+
+int sched_reschedule(enum sched_queue queue, struct k_work_delayable *work, k_timeout_t delay)
+{
+    if (queue >= SCHED_TOP)
+    {
+        return -EINVAL;
+    }
+
+    return k_work_reschedule_for_queue(&sched.queue[queue], work, delay);
+}
+
+void sched_jitter_reset(void)
+{
+#ifdef CONFIG_APP_JITTER_STATS
+    memset(&sched.jitter, 0, sizeof(sched.jitter));
+    sched.jitter.min_us = INT32_MAX;
+    sched.jitter.max_us = INT32_MIN;
+    sched.last_batch_cyc = 0;
+#endif
+}
+
+/*
+ * Record a batch of samples served now. The jitter is the difference
+ * between the time elapsed since the previous batch and the time the
+ * samples of this batch took to be acquired.
+ */
+void sched_jitter_record(uint32_t samples, uint32_t period_us, bool deadline_missed)
+{
+#ifdef CONFIG_APP_JITTER_STATS
+    uint32_t now = k_cycle_get_32();
+
+    if (deadline_missed)
+    {
+        sched.jitter.deadline_misses++;
+    }
+
+    if (sched.last_batch_cyc != 0)
+    {
+        int32_t elapsed_us = (int32_t)k_cyc_to_us_near32(now - sched.last_batch_cyc);
+        int32_t jitter_us = elapsed_us - (int32_t)(samples * period_us);
+
+        sched.jitter.batches++;
+        sched.jitter.min_us = MIN(sched.jitter.min_us, jitter_us);
+        sched.jitter.max_us = MAX(sched.jitter.max_us, jitter_us);
+        sched.jitter.abs_sum_us += (jitter_us < 0) ? -jitter_us : jitter_us;
+    }
+
+    sched.last_batch_cyc = now;
+#endif
+}
+
+void sched_jitter_report(void)
+{
+#ifdef CONFIG_APP_JITTER_STATS
+    if (sched.jitter.batches == 0)
+    {
+        return;
+    }
+
+    LOG_INF("Jitter: %u batches, min %d us, max %d us, mean abs %u us, %u deadline misses",
+        sched.jitter.batches, sched.jitter.min_us, sched.jitter.max_us,
+        (uint32_t)(sched.jitter.abs_sum_us / sched.jitter.batches), sched.jitter.deadline_misses);
+#endif
+}
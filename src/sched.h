@@ -0,0 +1,38 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <zephyr/kernel.h>
+
+enum sched_queue
+{
+    SCHED_ACQ,
+    SCHED_DSP,
+
+    SCHED_TOP,
+};
+
+struct sched_jitter_stats
+{
+    uint32_t batches;
+    uint32_t deadline_misses;
+    int32_t min_us;
+    int32_t max_us;
+    uint64_t abs_sum_us;
+};
+
+void sched_init(void);
+
+/* For the drivers which run their own work items on a given queue */
+struct k_work_q *sched_queue_get(enum sched_queue queue);
+
+int sched_submit(enum sched_queue queue, struct k_work *work);
+
+int sched_reschedule(enum sched_queue queue, struct k_work_delayable *work, k_timeout_t delay);
+
+void sched_jitter_reset(void);
+
+void sched_jitter_record(uint32_t samples, uint32_t period_us, bool deadline_missed);
+
+void sched_jitter_report(void);
+
+#endif /* SCHED_H */
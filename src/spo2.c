@@ -1,35 +1,60 @@
+#include <stdlib.h>
 #include <zephyr/kernel.h>
 #include <zephyr/device.h>
 #include <zephyr/devicetree.h>
 #include <zephyr/drivers/sensor.h>
+#include <zephyr/pm/device_runtime.h>
+#include <zephyr/timing/timing.h>
 
 #include <zephyr/logging/log.h>
-LOG_MODULE_REGISTER(spo2, CONFIG_LOG_DEFAULT_LEVEL);
-
-#include "math.h"
-
-#include "display.h"
+LOG_MODULE_REGISTER(spo2, CONFIG_APP_SPO2_LOG_LEVEL);
+
+#include "max30102.h"
+
+#include "channels.h"
+#include "hr.h"
+#include "power.h"
+#include "sample_block.h"
+#include "sched.h"
+#include "spo2_agc.h"
+#include "spo2_filter.h"
+#include "spo2_window.h"
 #include "spo2.h"
 
-#define SPO2_MEASUREMENT_PERIOD_S    5
-#define SPO2_MEASUREMENT_TIME_S      (SPO2_MEASUREMENT_PERIOD_S + 1)
-#define SPO2_SAMPLING_TIME_MS        10
-#define SPO2_BUFFER_SIZE             (SPO2_MEASUREMENT_PERIOD_S * 1000) / SPO2_SAMPLING_TIME_MS
-#define SPO2_SAMPLES_TO_IGNORE       100
+/* A single reading gives up on a window clear of AGC changes after twice its length */
+#define SPO2_MAX_SAMPLES    (2 * SPO2_WINDOW_SIZE)
+
+/* Blocks read by the MAX30102 trigger, waiting for the DSP queue; each holds a reference */
+K_MSGQ_DEFINE(spo2_block_msgq, sizeof(struct sample_block *), CONFIG_APP_SAMPLE_BLOCKS, 4);
 
 struct spo2_ctx
 {
-    uint16_t index;
-    uint16_t samples_to_ignore_cnt;
-    uint32_t red_buf[SPO2_BUFFER_SIZE];
-    uint32_t ir_buf[SPO2_BUFFER_SIZE];
+    struct spo2_window window;
+#ifdef CONFIG_APP_SPO2_FILTER
+    struct spo2_filter red_filter;
+    struct spo2_filter ir_filter;
+    struct spo2_window ac_window;
+#endif
+    struct hr_detector hr;
+#ifdef CONFIG_APP_HR_CYCLE_STATS
+    uint64_t hr_cycles;
+    uint32_t hr_samples;
+#endif
+    uint16_t samples_since_update;
+#ifdef CONFIG_APP_SPO2_AGC
+    uint16_t samples_cnt;
+#endif
     uint8_t current_val;
     bool measurement_in_progress;
-    struct k_timer measurement_timer;
-    struct k_timer sampling_timer;
+    /* The window is complete, the blocks still queued are dropped */
+    bool window_done;
+    struct sensor_trigger trigger;
     struct k_work button_pressed;
+    struct k_work block_process;
     struct k_work measurement_done;
-    struct k_work sampling_work;
+#ifdef CONFIG_APP_SPO2_CONTINUOUS
+    struct k_work stop;
+#endif
 };
 
 static struct spo2_ctx spo2;
@@ -59,149 +84,396 @@ static const struct device *get_max30102_device(void)
     return dev;
 }
 
-static void spo2_power_mode_set(bool enable)
+/*
+ * The driver shuts the sensor down while nobody holds it and flushes its
+ * FIFO on resume, so the first samples read are already valid.
+ */
+static void spo2_power_mode_set(const struct device *dev, bool enable)
 {
-    const struct device *dev = get_max30102_device();
-    if (dev == NULL)
+#ifdef CONFIG_APP_POWER
+    /* The power manager resumes the sensor bus before the sensor */
+    if (enable)
     {
-        LOG_ERR("\nError: no device found.\n");
-        return;
+        power_measurement_start(dev);
+    }
+    else
+    {
+        power_measurement_stop(dev);
     }
+#else
+    int err = enable ? pm_device_runtime_get(dev) : pm_device_runtime_put(dev);
 
-    struct sensor_value val = {enable, 0};
-    if (sensor_attr_set(dev, SENSOR_CHAN_RED, SENSOR_ATTR_CONFIGURATION, &val) <0)
+    if (err < 0)
     {
-        LOG_ERR("\nError: Attributes could not be configured.\n");
-        return;
+        LOG_ERR("Could not %s the sensor\n", enable ? "resume" : "suspend");
     }
+#endif
 }
 
 static uint8_t spo2_calculate(void)
 {
-    uint64_t red_sum = 0;
-    uint64_t ir_sum = 0;
-    uint64_t red_squared_sum = 0;
-    uint64_t ir_squared_sum = 0;
-    uint32_t red_mean = 0;
-    uint32_t ir_mean = 0;
+#ifdef CONFIG_APP_SPO2_FILTER
+    const struct spo2_window *ac = &spo2.ac_window;
+#else
+    const struct spo2_window *ac = &spo2.window;
+#endif
+    uint8_t val;
+
+#ifdef CONFIG_APP_SPO2_AGC
+    /* The DC and AC levels of a window spanning a gain change are meaningless */
+    if (spo2_agc_changed_within(spo2.window.count))
+    {
+        LOG_DBG("Window spans an AGC change, rejected");
+        return 0;
+    }
+#endif
+
+    val = spo2_window_calculate(&spo2.window, ac);
 
-    for (uint16_t i = 0; i < SPO2_BUFFER_SIZE; i++)
+#ifdef CONFIG_APP_SPO2_FIXED_POINT_CHECK
+    uint8_t ref = spo2_window_calculate_float(&spo2.window, ac);
+
+    if (abs(val - ref) > 1)
     {
-        red_sum += spo2.red_buf[i];
-        ir_sum += spo2.ir_buf[i];
+        LOG_WRN("Fixed point SpO2 %d %% differs from reference %d %%", val, ref);
     }
+#endif
+
+    return val;
+}
+
+static void spo2_hr_sample_add(uint32_t ir)
+{
+#ifdef CONFIG_APP_HR_CYCLE_STATS
+    timing_t start = timing_counter_get();
+
+    hr_sample_add(&spo2.hr, ir);
+
+    timing_t end = timing_counter_get();
 
-    red_mean = red_sum / SPO2_BUFFER_SIZE;
-    ir_mean = ir_sum / SPO2_BUFFER_SIZE;
+    spo2.hr_cycles += timing_cycles_get(&start, &end);
+    spo2.hr_samples++;
+#else
+    hr_sample_add(&spo2.hr, ir);
+#endif
+}
+
+static void spo2_publish(void)
+{
+    struct spo2_msg msg = {.spo2 = spo2.current_val, .hr = hr_bpm_get(&spo2.hr)};
 
-    for (uint16_t i = 0; i < SPO2_BUFFER_SIZE; i++)
+    if (zbus_chan_pub(&spo2_chan, &msg, CHAN_PUB_TIMEOUT) < 0)
     {
-        red_squared_sum += (spo2.red_buf[i] - red_mean) * (spo2.red_buf[i] - red_mean);
-        ir_squared_sum += (spo2.ir_buf[i] - ir_mean) * (spo2.ir_buf[i] - ir_mean);
+        LOG_WRN("Could not publish the SpO2 reading");
     }
 
-    double AC_red = sqrt((double)red_squared_sum / (double)SPO2_MEASUREMENT_PERIOD_S);
-    double DC_red = (double)red_mean;
-    double AC_ir = sqrt((double)ir_squared_sum / (double)SPO2_MEASUREMENT_PERIOD_S);
-    double DC_ir = (double)ir_mean;
+#ifdef CONFIG_APP_HR_CYCLE_STATS
+    if (spo2.hr_samples != 0)
+    {
+        LOG_INF("HR detector: %u CPU cycles per sample", (uint32_t)(spo2.hr_cycles / spo2.hr_samples));
+    }
+#endif
+}
 
-    return 101.72 - 6.4619 * ((AC_red / DC_red) / (AC_ir / DC_ir));
+static void spo2_stop_sampling(const struct device *dev)
+{
+    if (sensor_trigger_set(dev, &spo2.trigger, NULL) < 0)
+    {
+        LOG_ERR("Could not disable the FIFO trigger\n");
+    }
+
+    spo2.window_done = true;
+    sched_submit(SCHED_DSP, &spo2.measurement_done);
 }
 
-static void spo2_sample_add_workqueue(struct k_work *item)
+#ifndef CONFIG_APP_SPO2_CONTINUOUS
+/* A single reading waits for a window clear of AGC changes, up to SPO2_MAX_SAMPLES */
+static bool spo2_window_settled(void)
 {
-    const struct device *dev = get_max30102_device();
+#ifdef CONFIG_APP_SPO2_AGC
+    return !spo2_agc_changed_within(spo2.window.count) || (spo2.samples_cnt >= SPO2_MAX_SAMPLES);
+#else
+    return true;
+#endif
+}
+#endif
 
-    if (dev == NULL)
+static void spo2_block_process(const struct device *dev, const struct sample_block *block)
+{
+    const uint32_t *red = block->red;
+    const uint32_t *ir = block->ir;
+    int count = block->count;
+
+#ifdef CONFIG_APP_SPO2_FILTER
+    int32_t red_ac[SAMPLE_BLOCK_SIZE];
+    int32_t ir_ac[SAMPLE_BLOCK_SIZE];
+
+    /* The filters start from the first sample, so no settling samples are needed */
+    spo2_filter_process(&spo2.red_filter, red, red_ac, count);
+    spo2_filter_process(&spo2.ir_filter, ir, ir_ac, count);
+#endif
+
+    for (int i = 0; i < count; i++)
     {
-        return;
+        spo2_window_add(&spo2.window, red[i], ir[i]);
+#ifdef CONFIG_APP_SPO2_FILTER
+        spo2_window_add(&spo2.ac_window, red_ac[i], ir_ac[i]);
+#endif
+        spo2_hr_sample_add(ir[i]);
+#ifdef CONFIG_APP_SPO2_AGC
+        spo2.samples_cnt++;
+#endif
+
+#ifdef CONFIG_APP_SPO2_CONTINUOUS
+        /* The window statistics are O(1), so they are published right away */
+        if (spo2_window_full(&spo2.window) &&
+            (++spo2.samples_since_update >= CONFIG_APP_SPO2_UPDATE_SAMPLES))
+        {
+            uint8_t val = spo2_calculate();
+
+            spo2.samples_since_update = 0;
+
+            /* A rejected window keeps the previous reading on display */
+            if (val != 0)
+            {
+                spo2.current_val = val;
+                spo2_publish();
+            }
+        }
+#else
+        if (spo2_window_full(&spo2.window) && spo2_window_settled())
+        {
+            spo2_stop_sampling(dev);
+            return;
+        }
+#endif
+    }
+
+#ifdef CONFIG_APP_SPO2_AGC
+    if (spo2_agc_block_process(dev, red, ir, count))
+    {
+#ifdef CONFIG_APP_SPO2_FILTER
+        /* Restart from the first sample at the new scale instead of filtering the step */
+        spo2_filter_init(&spo2.red_filter);
+        spo2_filter_init(&spo2.ir_filter);
+#endif
     }
+#endif
+}
 
-    struct sensor_value data[2];
+/*
+ * Runs on the DSP queue, so the windows, the filters, the heart rate
+ * detector and the AGC are only touched from there.
+ */
+static void spo2_block_process_workqueue(struct k_work *item)
+{
+    const struct device *dev = get_max30102_device();
+    struct sample_block *block;
 
-    if (sensor_sample_fetch(dev) < 0)
+    while (k_msgq_get(&spo2_block_msgq, &block, K_NO_WAIT) == 0)
     {
-        LOG_ERR("Error when fetching the data\n");
+        if ((dev != NULL) && !spo2.window_done)
+        {
+            spo2_block_process(dev, block);
+        }
+
+        sample_block_unref(block);
     }
+}
+
+static void spo2_fifo_watermark_handler(const struct device *dev, const struct sensor_trigger *trigger)
+{
+    struct sample_block *block = sample_block_alloc();
+    uint8_t overflow;
+    int count;
 
-    if (sensor_channel_get(dev, SENSOR_CHAN_RED, &data[0]) < 0)
+    if (block == NULL)
     {
-        LOG_ERR("Channel RED get error\n");
+        uint32_t red[SAMPLE_BLOCK_SIZE];
+        uint32_t ir[SAMPLE_BLOCK_SIZE];
+
+        /* Drain the FIFO anyway, or the watermark interrupt never fires again */
+        count = max30102_fifo_read(dev, red, ir, SAMPLE_BLOCK_SIZE, &overflow);
+        LOG_WRN("%d samples dropped, no free sample block", MAX(count, 0));
         return;
     }
 
-    if (sensor_channel_get(dev, SENSOR_CHAN_IR, &data[1]) < 0)
+    count = max30102_fifo_read(dev, block->red, block->ir, SAMPLE_BLOCK_SIZE, &overflow);
+    if (count < 0)
     {
-        LOG_ERR("Channel IR get error\n");
+        LOG_ERR("Error when fetching the data\n");
+        sample_block_unref(block);
         return;
     }
 
-    if (spo2.samples_to_ignore_cnt < SPO2_SAMPLES_TO_IGNORE)
+    if (overflow != 0)
+    {
+        LOG_WRN("%d samples lost in the FIFO", overflow);
+    }
+
+    sched_jitter_record(count, SPO2_SAMPLING_TIME_MS * USEC_PER_MSEC, overflow != 0);
+
+    block->count = count;
+
+    /* The block goes out by reference, observers copy nothing */
+    struct ppg_block_msg msg = {.block = block};
+
+    if (zbus_chan_pub(&ppg_block_chan, &msg, CHAN_PUB_TIMEOUT) < 0)
+    {
+        LOG_WRN("Could not publish the PPG block");
+    }
+
+    /* The reference taken at allocation goes with the block to the DSP queue */
+    if (k_msgq_put(&spo2_block_msgq, &block, K_NO_WAIT) < 0)
     {
-        spo2.samples_to_ignore_cnt++;
+        LOG_WRN("%d samples dropped, the DSP queue is full", count);
+        sample_block_unref(block);
         return;
     }
 
-    spo2.red_buf[spo2.index] = data[0].val1;
-    spo2.ir_buf[spo2.index] = data[1].val1;
-    LOG_INF("RED=%d, IR=%d", data[0].val1, data[1].val1);
-    spo2.index++;
+    sched_submit(SCHED_DSP, &spo2.block_process);
 }
 
 static void spo2_val_init(void)
 {
-    memset(spo2.red_buf, 0, SPO2_BUFFER_SIZE);
-    memset(spo2.ir_buf, 0, SPO2_BUFFER_SIZE);
-    spo2.index = 0;
-    spo2.measurement_in_progress = false;
-    spo2.samples_to_ignore_cnt = 0;
+    spo2_window_reset(&spo2.window);
+#ifdef CONFIG_APP_SPO2_FILTER
+    spo2_window_reset(&spo2.ac_window);
+    spo2_filter_init(&spo2.red_filter);
+    spo2_filter_init(&spo2.ir_filter);
+#endif
+    hr_reset(&spo2.hr);
+#ifdef CONFIG_APP_HR_CYCLE_STATS
+    spo2.hr_cycles = 0;
+    spo2.hr_samples = 0;
+#endif
+    spo2.window_done = false;
+    spo2.samples_since_update = 0;
+#ifdef CONFIG_APP_SPO2_AGC
+    spo2.samples_cnt = 0;
+    spo2_agc_reset();
+#endif
 }
 
-static void spo2_button_pressed_workqueue(struct k_work *item)
+static void spo2_start(void)
 {
-    spo2_power_mode_set(true);
-    k_timer_start(&spo2.sampling_timer, K_NO_WAIT, K_MSEC(SPO2_SAMPLING_TIME_MS));
-    k_timer_start(&spo2.measurement_timer, K_SECONDS(SPO2_MEASUREMENT_TIME_S), K_FOREVER);
+    const struct device *dev = get_max30102_device();
+
+    if (dev == NULL)
+    {
+        spo2.measurement_in_progress = false;
+        return;
+    }
+
+    spo2.measurement_in_progress = true;
+    spo2_power_mode_set(dev, true);
+    sched_jitter_reset();
+
+    /* Samples are drained in batches each time the FIFO is almost full */
+    if (sensor_trigger_set(dev, &spo2.trigger, spo2_fifo_watermark_handler) < 0)
+    {
+        LOG_ERR("Could not enable the FIFO trigger\n");
+        spo2_power_mode_set(dev, false);
+        spo2.measurement_in_progress = false;
+    }
 }
 
-static void spo2_measurement_done_workqueue(struct k_work *item)
+#ifdef CONFIG_APP_SPO2_CONTINUOUS
+/* Queued behind the blocks read before the trigger was disabled */
+static void spo2_stop_workqueue(struct k_work *item)
 {
-    k_timer_stop(&spo2.sampling_timer);
-    spo2.current_val = spo2_calculate();
     spo2_val_init();
-    display_print(SENSOR_SPO2, spo2.current_val);
-    spo2_power_mode_set(false);
 }
 
-static void spo2_sampling_timer_expiry(struct k_timer *timer_id)
+static void spo2_stop(void)
 {
-    k_work_submit(&spo2.sampling_work);
+    const struct device *dev = get_max30102_device();
+
+    if ((dev != NULL) && (sensor_trigger_set(dev, &spo2.trigger, NULL) < 0))
+    {
+        LOG_ERR("Could not disable the FIFO trigger\n");
+    }
+
+    sched_jitter_report();
+    spo2.measurement_in_progress = false;
+    sched_submit(SCHED_DSP, &spo2.stop);
+
+    if (dev != NULL)
+    {
+        spo2_power_mode_set(dev, false);
+    }
+}
+#endif
+
+static void spo2_button_pressed_workqueue(struct k_work *item)
+{
+#ifdef CONFIG_APP_SPO2_CONTINUOUS
+    /* The button toggles the continuous measurement */
+    if (spo2.measurement_in_progress)
+    {
+        spo2_stop();
+        return;
+    }
+#endif
+
+    spo2_start();
 }
 
-static void spo2_measurement_timer_expiry(struct k_timer *timer_id)
+static void spo2_measurement_done_workqueue(struct k_work *item)
 {
-    k_work_submit(&spo2.measurement_done);
+    sched_jitter_report();
+    spo2.current_val = spo2_calculate();
+    spo2_publish();
+    spo2_val_init();
+    spo2.measurement_in_progress = false;
+
+    const struct device *dev = get_max30102_device();
+
+    if (dev != NULL)
+    {
+        spo2_power_mode_set(dev, false);
+    }
 }
 
 void spo2_button_pressed(void)
 {
+#ifndef CONFIG_APP_SPO2_CONTINUOUS
     if (spo2.measurement_in_progress)
     {
         return;
     }
 
     spo2.measurement_in_progress = true;
+#endif
 
-    k_work_submit(&spo2.button_pressed);
+    sched_submit(SCHED_ACQ, &spo2.button_pressed);
 }
 
 void spo2_init(void)
 {
-    k_timer_init(&spo2.sampling_timer, spo2_sampling_timer_expiry, NULL);
-    k_timer_init(&spo2.measurement_timer, spo2_measurement_timer_expiry, NULL);
-    k_work_init(&spo2.sampling_work, spo2_sample_add_workqueue);
+    spo2.trigger.type = SENSOR_TRIG_FIFO_WATERMARK;
+    spo2.trigger.chan = SENSOR_CHAN_ALL;
+
     k_work_init(&spo2.button_pressed, spo2_button_pressed_workqueue);
+    k_work_init(&spo2.block_process, spo2_block_process_workqueue);
     k_work_init(&spo2.measurement_done, spo2_measurement_done_workqueue);
+#ifdef CONFIG_APP_SPO2_CONTINUOUS
+    k_work_init(&spo2.stop, spo2_stop_workqueue);
+#endif
 
-    spo2_power_mode_set(false);
+    spo2_val_init();
+
+#ifdef CONFIG_APP_HR_CYCLE_STATS
+    timing_init();
+    timing_start();
+#endif
+
+#ifdef CONFIG_APP_SPO2_AGC
+    const struct device *dev = get_max30102_device();
+
+    if ((dev == NULL) || (spo2_agc_init(dev) < 0))
+    {
+        LOG_ERR("Could not read the LED settings, the AGC is off\n");
+    }
+#endif
 }
@@ -0,0 +1,282 @@
+#include <zephyr/kernel.h>
+#include <zephyr/drivers/sensor.h>
+#include <zephyr/sys/util.h>
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(spo2_agc, CONFIG_LOG_DEFAULT_LEVEL);
+
+#include "max30102.h"
+
+#include "spo2_agc.h"
+
+#define SPO2_AGC_FULL_SCALE        MAX30102_FIFO_DATA_MASK
+#define SPO2_AGC_DC_LOW            ((SPO2_AGC_FULL_SCALE / 100) * CONFIG_APP_SPO2_AGC_DC_LOW)
+#define SPO2_AGC_DC_HIGH           ((SPO2_AGC_FULL_SCALE / 100) * CONFIG_APP_SPO2_AGC_DC_HIGH)
+#define SPO2_AGC_DC_TARGET         ((SPO2_AGC_DC_LOW + SPO2_AGC_DC_HIGH) / 2)
+/* A peak within 1/64 of the full scale is taken as clipped */
+#define SPO2_AGC_SATURATION        (SPO2_AGC_FULL_SCALE - (SPO2_AGC_FULL_SCALE / 64))
+
+/* 0.8 mA, below that the pulse drowns in the ADC noise */
+#define SPO2_AGC_LED_PA_MIN        4
+#define SPO2_AGC_LED_PA_MAX        UINT8_MAX
+
+/* Samples already converted when a setting is written, left out of the checks */
+#define SPO2_AGC_SETTLE_SAMPLES    4
+
+/*
+ * A range step halves or doubles the DC level and a pulse width step
+ * nearly does, so a level just out of the band must land inside it.
+ */
+BUILD_ASSERT(CONFIG_APP_SPO2_AGC_DC_HIGH > (2 * CONFIG_APP_SPO2_AGC_DC_LOW),
+    "The AGC band must span more than a factor of 2");
+
+enum spo2_agc_level
+{
+    SPO2_AGC_LOW,
+    SPO2_AGC_IN_BAND,
+    SPO2_AGC_HIGH,
+};
+
+struct spo2_agc_ctx
+{
+    /* Indexed by enum max30102_led_channel */
+    uint8_t led_pa[MAX30102_MAX_NUM_CHANNELS];
+    uint8_t adc_range;
+    uint8_t pulse_width;
+    /* Samples processed since the start of the measurement */
+    uint32_t samples;
+    /* First sample taken with the current settings */
+    uint32_t change_sample;
+    bool changed;
+    bool ready;
+};
+
+static struct spo2_agc_ctx agc;
+
+static const enum sensor_channel spo2_agc_chan[MAX30102_MAX_NUM_CHANNELS] =
+{
+    [MAX30102_LED_CHANNEL_RED] = SENSOR_CHAN_RED,
+    [MAX30102_LED_CHANNEL_IR] = SENSOR_CHAN_IR,
+};
+
+static const char *const spo2_agc_led_names[MAX30102_MAX_NUM_CHANNELS] =
+{
+    [MAX30102_LED_CHANNEL_RED] = "RED LED",
+    [MAX30102_LED_CHANNEL_IR] = "IR LED",
+};
+
+static int spo2_agc_setting_get(const struct device *dev, enum sensor_channel chan, int attr, uint8_t *setting)
+{
+    struct sensor_value val;
+    int err = sensor_attr_get(dev, chan, (enum sensor_attribute)attr, &val);
+
+    if (err < 0)
+    {
+        return err;
+    }
+
+    *setting = (uint8_t)val.val1;
+
+    return 0;
+}
+
+static bool spo2_agc_setting_set(const struct device *dev, enum sensor_channel chan, int attr, uint8_t *setting,
+    uint8_t next, const char *name)
+{
+    struct sensor_value val = {next, 0};
+
+    /* A pulse width too long for the sample rate is refused, it only stops the search */
+    if (sensor_attr_set(dev, chan, (enum sensor_attribute)attr, &val) < 0)
+    {
+        LOG_DBG("Could not set the %s to %u", name, next);
+        return false;
+    }
+
+    LOG_INF("%s %u -> %u at sample %u", name, *setting, next, agc.samples);
+    *setting = next;
+
+    return true;
+}
+
+static enum spo2_agc_level spo2_agc_level_get(const uint32_t *buf, int count, uint32_t *mean)
+{
+    uint64_t sum = 0;
+    uint32_t peak = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        sum += buf[i];
+        peak = MAX(peak, buf[i]);
+    }
+
+    *mean = (uint32_t)(sum / count);
+
+    if ((peak >= SPO2_AGC_SATURATION) || (*mean > SPO2_AGC_DC_HIGH))
+    {
+        return SPO2_AGC_HIGH;
+    }
+
+    return (*mean < SPO2_AGC_DC_LOW) ? SPO2_AGC_LOW : SPO2_AGC_IN_BAND;
+}
+
+/*
+ * With the ambient light cancelled by the sensor, the DC level follows
+ * the LED current, so the amplitude is scaled straight to the middle of
+ * the band. Returns the current amplitude once at the limit.
+ */
+static uint8_t spo2_agc_led_pa_next(uint8_t pa, enum spo2_agc_level level, uint32_t mean)
+{
+    uint32_t next = ((uint32_t)pa * SPO2_AGC_DC_TARGET) / MAX(mean, 1);
+
+    /* A clipped peak can leave the mean in the band, still step down */
+    next = (level == SPO2_AGC_HIGH) ? MIN(next, (uint32_t)pa - 1) : MAX(next, (uint32_t)pa + 1);
+
+    return (uint8_t)CLAMP(next, SPO2_AGC_LED_PA_MIN, SPO2_AGC_LED_PA_MAX);
+}
+
+/*
+ * Common to both channels, so only used once an amplitude is at its
+ * limit. Raising the level costs nothing with the range and LED current
+ * with the pulse width, lowering it saves the LED current first.
+ */
+static bool spo2_agc_sensitivity_step(const struct device *dev, bool raise)
+{
+    if (raise && (agc.adc_range > 0))
+    {
+        return spo2_agc_setting_set(dev, SENSOR_CHAN_ALL, SENSOR_ATTR_MAX30102_ADC_RANGE, &agc.adc_range,
+            agc.adc_range - 1, "ADC range");
+    }
+
+    if (raise && (agc.pulse_width < MAX30102_PW_18BITS))
+    {
+        return spo2_agc_setting_set(dev, SENSOR_CHAN_ALL, SENSOR_ATTR_MAX30102_PULSE_WIDTH, &agc.pulse_width,
+            agc.pulse_width + 1, "Pulse width");
+    }
+
+    if (!raise && (agc.pulse_width > MAX30102_PW_15BITS))
+    {
+        return spo2_agc_setting_set(dev, SENSOR_CHAN_ALL, SENSOR_ATTR_MAX30102_PULSE_WIDTH, &agc.pulse_width,
+            agc.pulse_width - 1, "Pulse width");
+    }
+
+    if (!raise && (agc.adc_range < MAX30102_SPO2_ADC_RGE_MAX))
+    {
+        return spo2_agc_setting_set(dev, SENSOR_CHAN_ALL, SENSOR_ATTR_MAX30102_ADC_RANGE, &agc.adc_range,
+            agc.adc_range + 1, "ADC range");
+    }
+
+    return false;
+}
+
+bool spo2_agc_block_process(const struct device *dev, const uint32_t *red, const uint32_t *ir, int count)
+{
+    const uint32_t *buf[MAX30102_MAX_NUM_CHANNELS] =
+    {
+        [MAX30102_LED_CHANNEL_RED] = red,
+        [MAX30102_LED_CHANNEL_IR] = ir,
+    };
+    uint32_t since_change = agc.samples - agc.change_sample;
+    bool high_at_limit = false;
+    bool low_at_limit = false;
+    bool changed = false;
+    int skip = 0;
+
+    if (!agc.ready)
+    {
+        return false;
+    }
+
+    if (agc.changed && (since_change < SPO2_AGC_SETTLE_SAMPLES))
+    {
+        skip = MIN(SPO2_AGC_SETTLE_SAMPLES - since_change, count);
+    }
+
+    agc.samples += count;
+
+    if (count <= skip)
+    {
+        return false;
+    }
+
+    for (int c = 0; c < MAX30102_MAX_NUM_CHANNELS; c++)
+    {
+        enum spo2_agc_level level;
+        uint32_t mean;
+        uint8_t next;
+
+        level = spo2_agc_level_get(buf[c] + skip, count - skip, &mean);
+        if (level == SPO2_AGC_IN_BAND)
+        {
+            continue;
+        }
+
+        next = spo2_agc_led_pa_next(agc.led_pa[c], level, mean);
+        if (next == agc.led_pa[c])
+        {
+            high_at_limit |= (level == SPO2_AGC_HIGH);
+            low_at_limit |= (level == SPO2_AGC_LOW);
+            continue;
+        }
+
+        changed |= spo2_agc_setting_set(dev, spo2_agc_chan[c], SENSOR_ATTR_MAX30102_LED_PA, &agc.led_pa[c],
+            next, spo2_agc_led_names[c]);
+    }
+
+    /* A clipped channel takes precedence over a weak one */
+    if (!changed && (high_at_limit || low_at_limit))
+    {
+        changed = spo2_agc_sensitivity_step(dev, !high_at_limit);
+    }
+
+    if (changed)
+    {
+        agc.changed = true;
+        agc.change_sample = agc.samples;
+    }
+
+    return changed;
+}
+
+bool spo2_agc_changed_within(uint32_t samples)
+{
+    return agc.changed && ((agc.samples - agc.change_sample) < (samples + SPO2_AGC_SETTLE_SAMPLES));
+}
+
+void spo2_agc_reset(void)
+{
+    agc.samples = 0;
+    agc.change_sample = 0;
+    agc.changed = false;
+}
+
+int spo2_agc_init(const struct device *dev)
+{
+    int err;
+
+    /* The settings found by the previous measurement are kept for the next one */
+    for (int c = 0; c < MAX30102_MAX_NUM_CHANNELS; c++)
+    {
+        err = spo2_agc_setting_get(dev, spo2_agc_chan[c], SENSOR_ATTR_MAX30102_LED_PA, &agc.led_pa[c]);
+        if (err < 0)
+        {
+            return err;
+        }
+    }
+
+    err = spo2_agc_setting_get(dev, SENSOR_CHAN_ALL, SENSOR_ATTR_MAX30102_ADC_RANGE, &agc.adc_range);
+    if (err < 0)
+    {
+        return err;
+    }
+
+    err = spo2_agc_setting_get(dev, SENSOR_CHAN_ALL, SENSOR_ATTR_MAX30102_PULSE_WIDTH, &agc.pulse_width);
+    if (err < 0)
+    {
+        return err;
+    }
+
+    spo2_agc_reset();
+    agc.ready = true;
+
+    return 0;
+}
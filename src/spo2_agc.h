@@ -0,0 +1,36 @@
+#ifndef SPO2_AGC_H
+#define SPO2_AGC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <zephyr/device.h>
+
+/*
+ * Automatic gain control of the MAX30102. The DC level of every block is
+ * kept between APP_SPO2_AGC_DC_LOW and APP_SPO2_AGC_DC_HIGH % of the ADC
+ * full scale, first with the LED pulse amplitude of each channel, then,
+ * once an amplitude hits its limit, with the ADC range and the pulse
+ * width common to both channels.
+ *
+ * Each adjustment is logged with the sample count it applies from, so
+ * that the readings can reject the windows spanning a change of scale.
+ */
+
+/* Read back the current settings from the driver, the AGC stays off on error */
+int spo2_agc_init(const struct device *dev);
+
+/* Restart the sample count at the start of a measurement */
+void spo2_agc_reset(void);
+
+/*
+ * Check the DC levels of a block and adjust the sensor when they leave
+ * the target band. Called after each block read from the FIFO, in the
+ * same context. Returns true when a setting changed, i.e. the samples
+ * from the next block on are on another scale.
+ */
+bool spo2_agc_block_process(const struct device *dev, const uint32_t *red, const uint32_t *ir, int count);
+
+/* Whether a setting changed within the last samples processed */
+bool spo2_agc_changed_within(uint32_t samples);
+
+#endif /* SPO2_AGC_H */
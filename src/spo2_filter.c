@@ -0,0 +1,134 @@
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/sys/util.h>
+
+#include "spo2_filter.h"
+
+#define SPO2_FILTER_STATE_SHIFT    8
+
+/* y[n] = x[n] - x[n-1] + 0.995 * y[n-1], a 0.08 Hz high-pass at 100 Hz */
+static const int32_t dc_blocker_coeff[5] = {32604, 0, 0, 0, 0};
+
+/* RBJ band-pass, 0.5 to 5 Hz at -3 dB, 100 Hz sampling */
+static const int32_t bandpass_coeff[5] = {133073156, 0, -133073156, -1872060942, 807595513};
+
+void spo2_filter_init(struct spo2_filter *filter)
+{
+    memset(filter, 0, sizeof(*filter));
+
+    if (IS_ENABLED(CONFIG_APP_SPO2_FILTER_DC_BLOCKER))
+    {
+        spo2_filter_stage_add(filter, SPO2_FILTER_DC_BLOCKER, dc_blocker_coeff);
+    }
+
+    if (IS_ENABLED(CONFIG_APP_SPO2_FILTER_BANDPASS))
+    {
+        spo2_filter_stage_add(filter, SPO2_FILTER_BIQUAD, bandpass_coeff);
+    }
+}
+
+int spo2_filter_stage_add(struct spo2_filter *filter, enum spo2_filter_type type, const int32_t *coeff)
+{
+    struct spo2_filter_stage *stage;
+
+    if ((filter->num_stages == SPO2_FILTER_MAX_STAGES) || (type >= SPO2_FILTER_TOP))
+    {
+        return -ENOMEM;
+    }
+
+    stage = &filter->stage[filter->num_stages++];
+    memset(stage, 0, sizeof(*stage));
+    stage->type = type;
+    memcpy(stage->coeff, coeff, sizeof(stage->coeff));
+
+    return 0;
+}
+
+static void spo2_filter_dc_blocker(struct spo2_filter_stage *stage, int32_t *buf, size_t len)
+{
+    int32_t x1 = stage->x1;
+    int32_t y1 = stage->y1;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        int32_t x = buf[i];
+
+        y1 = x - x1 + (int32_t)(((int64_t)stage->coeff[0] * y1) >> 15);
+        x1 = x;
+        buf[i] = y1;
+    }
+
+    stage->x1 = x1;
+    stage->y1 = y1;
+}
+
+static void spo2_filter_biquad(struct spo2_filter_stage *stage, int32_t *buf, size_t len)
+{
+    const int32_t *c = stage->coeff;
+    int32_t x1 = stage->x1;
+    int32_t x2 = stage->x2;
+    int32_t y1 = stage->y1;
+    int32_t y2 = stage->y2;
+
+    /* Direct form I, the 64-bit accumulation maps to SMLAL on Cortex-M4 */
+    for (size_t i = 0; i < len; i++)
+    {
+        int32_t x = buf[i];
+        int64_t acc = ((int64_t)c[0] * x) + ((int64_t)c[1] * x1) + ((int64_t)c[2] * x2) -
+            ((int64_t)c[3] * y1) - ((int64_t)c[4] * y2);
+
+        x2 = x1;
+        x1 = x;
+        y2 = y1;
+        y1 = (int32_t)(acc >> 30);
+        buf[i] = y1;
+    }
+
+    stage->x1 = x1;
+    stage->x2 = x2;
+    stage->y1 = y1;
+    stage->y2 = y2;
+}
+
+void spo2_filter_process(struct spo2_filter *filter, const uint32_t *in, int32_t *out, size_t len)
+{
+    if (len == 0)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < len; i++)
+    {
+        out[i] = (int32_t)(in[i] << SPO2_FILTER_STATE_SHIFT);
+    }
+
+    /* Start from the steady state of the first sample to avoid a DC step */
+    if (!filter->primed && (filter->num_stages > 0))
+    {
+        filter->stage[0].x1 = out[0];
+        filter->stage[0].x2 = out[0];
+        filter->primed = true;
+    }
+
+    /* Each stage runs over the whole block before the next one */
+    for (uint8_t s = 0; s < filter->num_stages; s++)
+    {
+        switch (filter->stage[s].type)
+        {
+            case SPO2_FILTER_DC_BLOCKER:
+                spo2_filter_dc_blocker(&filter->stage[s], out, len);
+                break;
+            case SPO2_FILTER_BIQUAD:
+                spo2_filter_biquad(&filter->stage[s], out, len);
+                break;
+            default:
+                break;
+        }
+    }
+
+    for (size_t i = 0; i < len; i++)
+    {
+        out[i] = (out[i] + (1 << (SPO2_FILTER_STATE_SHIFT - 1))) >> SPO2_FILTER_STATE_SHIFT;
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef SPO2_FILTER_H
+#define SPO2_FILTER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SPO2_FILTER_MAX_STAGES    2
+
+enum spo2_filter_type
+{
+    SPO2_FILTER_DC_BLOCKER,
+    SPO2_FILTER_BIQUAD,
+
+    SPO2_FILTER_TOP,
+};
+
+/*
+ * One filter stage. The DC blocker only uses coeff[0], its pole in Q15.
+ * The biquad uses b0, b1, b2, a1, a2 in Q30. The states are in Q8 to keep
+ * the low frequency poles accurate.
+ */
+struct spo2_filter_stage
+{
+    enum spo2_filter_type type;
+    int32_t coeff[5];
+    int32_t x1;
+    int32_t x2;
+    int32_t y1;
+    int32_t y2;
+};
+
+/* Chain of stages applied in order to one channel */
+struct spo2_filter
+{
+    struct spo2_filter_stage stage[SPO2_FILTER_MAX_STAGES];
+    uint8_t num_stages;
+    bool primed;
+};
+
+/* Build the chain selected in Kconfig */
+void spo2_filter_init(struct spo2_filter *filter);
+
+int spo2_filter_stage_add(struct spo2_filter *filter, enum spo2_filter_type type, const int32_t *coeff);
+
+/* Filter a block of raw samples, the output is in ADC counts */
+void spo2_filter_process(struct spo2_filter *filter, const uint32_t *in, int32_t *out, size_t len);
+
+#endif /* SPO2_FILTER_H */
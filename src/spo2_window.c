@@ -0,0 +1,168 @@
+#include <string.h>
+#include <math.h>
+
+#include <zephyr/sys/util.h>
+
+#include "spo2_window.h"
+
+#define SPO2_MAX    100
+
+/* Calibration curve 101.72 - 6.4619 * R in Q16 */
+#define SPO2_CALIB_OFFSET_Q16    6666322LL
+#define SPO2_CALIB_SLOPE_Q16     423487LL
+
+/* Largest numerator which can still be shifted into Q16 */
+#define SPO2_Q16_NUM_BITS        47
+
+void spo2_window_reset(struct spo2_window *window)
+{
+    memset(window, 0, sizeof(*window));
+}
+
+void spo2_window_add(struct spo2_window *window, int32_t red, int32_t ir)
+{
+    if (window->count == SPO2_WINDOW_SIZE)
+    {
+        /* Evict the oldest sample which is about to be overwritten */
+        int32_t old_red = window->red_buf[window->head];
+        int32_t old_ir = window->ir_buf[window->head];
+
+        window->red_sum -= old_red;
+        window->ir_sum -= old_ir;
+        window->red_squared_sum -= (uint64_t)((int64_t)old_red * old_red);
+        window->ir_squared_sum -= (uint64_t)((int64_t)old_ir * old_ir);
+    }
+    else
+    {
+        window->count++;
+    }
+
+    window->red_buf[window->head] = red;
+    window->ir_buf[window->head] = ir;
+    window->red_sum += red;
+    window->ir_sum += ir;
+    window->red_squared_sum += (uint64_t)((int64_t)red * red);
+    window->ir_squared_sum += (uint64_t)((int64_t)ir * ir);
+
+    window->head = (window->head + 1) % SPO2_WINDOW_SIZE;
+}
+
+bool spo2_window_full(const struct spo2_window *window)
+{
+    return window->count == SPO2_WINDOW_SIZE;
+}
+
+/*
+ * n * sum((x - mean)^2) = n * sum(x^2) - sum(x)^2 is exact in 64 bits for
+ * 18-bit samples. The common n factors cancel out in the ratio
+ * R = (AC_red / DC_red) / (AC_ir / DC_ir), so they are never divided out.
+ */
+static bool spo2_window_variance(const struct spo2_window *dc, const struct spo2_window *ac,
+    uint64_t *red_var, uint64_t *ir_var)
+{
+    uint64_t n = ac->count;
+
+    if ((n == 0) || (dc->red_sum <= 0) || (dc->ir_sum <= 0))
+    {
+        return false;
+    }
+
+    *red_var = (n * ac->red_squared_sum) - (uint64_t)(ac->red_sum * ac->red_sum);
+    *ir_var = (n * ac->ir_squared_sum) - (uint64_t)(ac->ir_sum * ac->ir_sum);
+
+    return *ir_var != 0;
+}
+
+static uint32_t spo2_isqrt64(uint64_t val)
+{
+    uint64_t res = 0;
+    uint64_t bit = 1ULL << 62;
+
+    while (bit > val)
+    {
+        bit >>= 2;
+    }
+
+    while (bit != 0)
+    {
+        if (val >= res + bit)
+        {
+            val -= res + bit;
+            res = (res >> 1) + bit;
+        }
+        else
+        {
+            res >>= 1;
+        }
+        bit >>= 2;
+    }
+
+    return (uint32_t)res;
+}
+
+static uint8_t spo2_bit_length(uint64_t val)
+{
+    return (val == 0) ? 0 : (64 - __builtin_clzll(val));
+}
+
+uint8_t spo2_window_calculate_float(const struct spo2_window *dc, const struct spo2_window *ac)
+{
+    uint64_t red_var;
+    uint64_t ir_var;
+
+    if (!spo2_window_variance(dc, ac, &red_var, &ir_var))
+    {
+        return 0;
+    }
+
+    double AC_red = sqrt((double)red_var);
+    double DC_red = (double)dc->red_sum;
+    double AC_ir = sqrt((double)ir_var);
+    double DC_ir = (double)dc->ir_sum;
+
+    double spo2 = 101.72 - 6.4619 * ((AC_red / DC_red) / (AC_ir / DC_ir));
+
+    return (uint8_t)CLAMP(spo2, 0.0, SPO2_MAX);
+}
+
+uint8_t spo2_window_calculate_fixed(const struct spo2_window *dc, const struct spo2_window *ac)
+{
+    uint64_t red_var;
+    uint64_t ir_var;
+
+    if (!spo2_window_variance(dc, ac, &red_var, &ir_var))
+    {
+        return 0;
+    }
+
+    /*
+     * R = (sqrt(red_var) * ir_sum) / (sqrt(ir_var) * red_sum). Both terms
+     * are below 2^54; they are scaled down together so that the numerator
+     * leaves room for the Q16 shift.
+     */
+    uint64_t num = (uint64_t)spo2_isqrt64(red_var) * (uint64_t)dc->ir_sum;
+    uint64_t den = (uint64_t)spo2_isqrt64(ir_var) * (uint64_t)dc->red_sum;
+    uint8_t shift = MAX(spo2_bit_length(num), SPO2_Q16_NUM_BITS) - SPO2_Q16_NUM_BITS;
+
+    num >>= shift;
+    den >>= shift;
+    if (den == 0)
+    {
+        return 0;
+    }
+
+    int64_t ratio = (int64_t)((num << 16) / den);
+    int64_t spo2 = SPO2_CALIB_OFFSET_Q16 - ((SPO2_CALIB_SLOPE_Q16 * ratio) >> 16);
+
+    return (uint8_t)(CLAMP(spo2, 0, SPO2_MAX << 16) >> 16);
+}
+
+uint8_t spo2_window_calculate(const struct spo2_window *dc, const struct spo2_window *ac)
+{
+    if (IS_ENABLED(CONFIG_APP_SPO2_FIXED_POINT))
+    {
+        return spo2_window_calculate_fixed(dc, ac);
+    }
+
+    return spo2_window_calculate_float(dc, ac);
+}
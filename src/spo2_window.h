@@ -0,0 +1,48 @@
+#ifndef SPO2_WINDOW_H
+#define SPO2_WINDOW_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SPO2_MEASUREMENT_PERIOD_S    CONFIG_APP_SPO2_WINDOW_S
+#define SPO2_SAMPLING_TIME_MS        10
+#define SPO2_WINDOW_SIZE             ((SPO2_MEASUREMENT_PERIOD_S * 1000) / SPO2_SAMPLING_TIME_MS)
+
+/*
+ * Sliding window over the last SPO2_WINDOW_SIZE RED/IR samples. The sums
+ * and sums of squares are kept up to date on every sample, so the window
+ * statistics never need another pass over the buffers. Samples are signed
+ * so that the same window can hold raw or band-passed values.
+ */
+struct spo2_window
+{
+    int32_t red_buf[SPO2_WINDOW_SIZE];
+    int32_t ir_buf[SPO2_WINDOW_SIZE];
+    uint16_t head;
+    uint16_t count;
+    int64_t red_sum;
+    int64_t ir_sum;
+    uint64_t red_squared_sum;
+    uint64_t ir_squared_sum;
+};
+
+void spo2_window_reset(struct spo2_window *window);
+
+void spo2_window_add(struct spo2_window *window, int32_t red, int32_t ir);
+
+bool spo2_window_full(const struct spo2_window *window);
+
+/*
+ * SpO2 computed by the path selected by APP_SPO2_FIXED_POINT. The DC levels
+ * are the means of the raw dc window and the AC levels are the standard
+ * deviations of the ac window. Without filtering both are the same window.
+ */
+uint8_t spo2_window_calculate(const struct spo2_window *dc, const struct spo2_window *ac);
+
+/* Double precision reference */
+uint8_t spo2_window_calculate_float(const struct spo2_window *dc, const struct spo2_window *ac);
+
+/* Integer only computation with the ratio and calibration curve in Q16 */
+uint8_t spo2_window_calculate_fixed(const struct spo2_window *dc, const struct spo2_window *ac);
+
+#endif /* SPO2_WINDOW_H */
@@ -0,0 +1,120 @@
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/crc.h>
+#include <zephyr/zbus/zbus.h>
+#include <SEGGER_RTT.h>
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(stream, CONFIG_LOG_DEFAULT_LEVEL);
+
+#include "channels.h"
+#include "sample_block.h"
+#include "stream.h"
+
+#define STREAM_SYNC            0xa55a
+#define STREAM_HEADER_SIZE     10
+#define STREAM_CRC_SIZE        2
+#define STREAM_SAMPLE_SIZE     3
+#define STREAM_PAYLOAD_MAX     (1 + (SAMPLE_BLOCK_SIZE * 2 * STREAM_SAMPLE_SIZE))
+#define STREAM_FRAME_MAX       (STREAM_HEADER_SIZE + STREAM_PAYLOAD_MAX + STREAM_CRC_SIZE)
+
+BUILD_ASSERT(STREAM_PAYLOAD_MAX <= UINT8_MAX, "The payload length is a single byte");
+
+struct stream_ctx
+{
+    uint8_t buf[CONFIG_APP_STREAM_BUFFER_SIZE];
+    atomic_t seq;
+    bool ready;
+};
+
+static struct stream_ctx stream;
+
+/*
+ * The frame is built on the stack and written in one call. In skip mode
+ * RTT takes it whole or not at all, so the publishers never wait for
+ * the host and a full buffer only costs whole frames.
+ */
+static void stream_frame_send(uint8_t type, uint32_t time_ms, const uint8_t *payload, uint8_t len)
+{
+    uint8_t frame[STREAM_FRAME_MAX];
+    uint16_t crc;
+
+    sys_put_le16(STREAM_SYNC, &frame[0]);
+    frame[2] = type;
+    frame[3] = len;
+    sys_put_le16((uint16_t)atomic_inc(&stream.seq), &frame[4]);
+    sys_put_le32(time_ms, &frame[6]);
+    memcpy(&frame[STREAM_HEADER_SIZE], payload, len);
+
+    crc = crc16_ccitt(0, &frame[2], STREAM_HEADER_SIZE - 2 + len);
+    sys_put_le16(crc, &frame[STREAM_HEADER_SIZE + len]);
+
+    /* A dropped frame still used its sequence number, the host sees the gap */
+    SEGGER_RTT_Write(CONFIG_APP_STREAM_RTT_CHANNEL, frame, STREAM_HEADER_SIZE + len + STREAM_CRC_SIZE);
+}
+
+static void stream_ppg_send(const struct sample_block *block)
+{
+    uint8_t payload[STREAM_PAYLOAD_MAX];
+    uint8_t *sample = &payload[1];
+
+    payload[0] = (uint8_t)block->count;
+
+    for (uint16_t i = 0; i < block->count; i++)
+    {
+        sys_put_le24(block->red[i], sample);
+        sys_put_le24(block->ir[i], sample + STREAM_SAMPLE_SIZE);
+        sample += 2 * STREAM_SAMPLE_SIZE;
+    }
+
+    stream_frame_send(STREAM_PPG, block->time_ms, payload, sample - payload);
+}
+
+/*
+ * Runs in the publisher context, i.e. the MAX30102 trigger for the PPG
+ * blocks and the acquisition queue, see stc31_work_queue_set(), for CO2
+ */
+static void stream_chan_cb(const struct zbus_channel *chan)
+{
+    if (!stream.ready)
+    {
+        return;
+    }
+
+    if (chan == &ppg_block_chan)
+    {
+        const struct ppg_block_msg *msg = zbus_chan_const_msg(chan);
+
+        stream_ppg_send(msg->block);
+    }
+    else if (chan == &co2_raw_chan)
+    {
+        const struct co2_raw_msg *msg = zbus_chan_const_msg(chan);
+        uint8_t payload[2];
+
+        sys_put_le16(msg->co2, payload);
+        stream_frame_send(STREAM_CO2, msg->time_ms, payload, sizeof(payload));
+    }
+}
+
+ZBUS_LISTENER_DEFINE(stream_lis, stream_chan_cb);
+
+ZBUS_CHAN_ADD_OBS(ppg_block_chan, stream_lis, 2);
+ZBUS_CHAN_ADD_OBS(co2_raw_chan, stream_lis, 2);
+
+int stream_init(void)
+{
+    int err = SEGGER_RTT_ConfigUpBuffer(CONFIG_APP_STREAM_RTT_CHANNEL, "samples", stream.buf,
+        sizeof(stream.buf), SEGGER_RTT_MODE_NO_BLOCK_SKIP);
+
+    if (err < 0)
+    {
+        LOG_ERR("Could not configure the RTT up-buffer %d\n", CONFIG_APP_STREAM_RTT_CHANNEL);
+        return -EIO;
+    }
+
+    stream.ready = true;
+
+    return 0;
+}
@@ -0,0 +1,30 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+/*
+ * Binary streaming of the raw samples over a dedicated RTT up-buffer,
+ * in place of text logs. Each frame is self-contained:
+ *
+ *   sync      2 bytes  0x5a 0xa5
+ *   type      1 byte   enum stream_type
+ *   length    1 byte   payload length
+ *   seq       2 bytes  frame counter, a gap means dropped frames
+ *   time_ms   4 bytes  uptime of the sample, or the last of a block
+ *   payload   length bytes
+ *   crc       2 bytes  CRC-16/CCITT of the fields from type on
+ *
+ * A PPG payload is the sample count, then per sample the red and IR
+ * values on 3 bytes each. A CO2 payload is the CO2 in 1/100 vol% on
+ * 2 bytes. All the fields are little endian; scripts/stream_decode.py
+ * turns a capture into CSV.
+ */
+
+enum stream_type
+{
+    STREAM_PPG = 1,
+    STREAM_CO2,
+};
+
+int stream_init(void);
+
+#endif /* STREAM_H */
@@ -0,0 +1,225 @@
+#include <stdlib.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/spsc_lockfree.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/zbus/zbus.h>
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(wave, CONFIG_LOG_DEFAULT_LEVEL);
+
+#include "channels.h"
+#include "display.h"
+#include "wave.h"
+
+/* One chart point per column of the 128 px wide screen */
+#define WAVE_POINTS            128
+#define WAVE_CHART_HEIGHT      24
+#define WAVE_PPG_OFFSET_Y      16
+#define WAVE_CO2_OFFSET_Y      (WAVE_PPG_OFFSET_Y + WAVE_CHART_HEIGHT)
+
+/* More than a second of points, so a slow frame does not drop any */
+#define WAVE_PPG_QUEUE_SIZE    32
+#define WAVE_CO2_QUEUE_SIZE    16
+
+/* The PPG is plotted in +/- 100 of its recent peak to peak amplitude */
+#define WAVE_PPG_RANGE         100
+/* The DC tracker cutoff is about 25 Hz / (2 * pi * 2^5) = 0.12 Hz */
+#define WAVE_DC_SHIFT          5
+/* The amplitude decays with a time constant of 2^6 points */
+#define WAVE_ENVELOPE_SHIFT    6
+
+/* The capnogram is plotted from 0 to 8 vol% */
+#define WAVE_CO2_FULL_SCALE    800
+
+SPSC_DEFINE(wave_ppg_queue, int32_t, WAVE_PPG_QUEUE_SIZE)
+SPSC_DEFINE(wave_co2_queue, uint16_t, WAVE_CO2_QUEUE_SIZE)
+
+struct wave_ctx
+{
+    /* Producer side */
+    uint32_t ppg_sum;
+    uint8_t ppg_cnt;
+    atomic_t dropped;
+    /* Consumer side */
+    lv_obj_t *ppg_chart;
+    lv_obj_t *co2_chart;
+    lv_chart_series_t *ppg_series;
+    lv_chart_series_t *co2_series;
+    int32_t dc_q8;
+    int32_t envelope;
+    bool dc_valid;
+    uint32_t dropped_reported;
+};
+
+static struct wave_ctx wave;
+
+static void wave_ppg_add(const uint32_t *ir, int count)
+{
+    bool added = false;
+
+    for (int i = 0; i < count; i++)
+    {
+        wave.ppg_sum += ir[i];
+
+        if (++wave.ppg_cnt < CONFIG_APP_WAVEFORM_PPG_DECIMATION)
+        {
+            continue;
+        }
+
+        int32_t *point = spsc_acquire(&wave_ppg_queue);
+
+        if (point != NULL)
+        {
+            *point = (int32_t)(wave.ppg_sum / CONFIG_APP_WAVEFORM_PPG_DECIMATION);
+            spsc_produce(&wave_ppg_queue);
+            added = true;
+        }
+        else
+        {
+            atomic_inc(&wave.dropped);
+        }
+
+        wave.ppg_sum = 0;
+        wave.ppg_cnt = 0;
+    }
+
+    if (added)
+    {
+        display_frame_request();
+    }
+}
+
+static void wave_co2_add(uint16_t co2)
+{
+    uint16_t *point = spsc_acquire(&wave_co2_queue);
+
+    if (point == NULL)
+    {
+        atomic_inc(&wave.dropped);
+        return;
+    }
+
+    *point = co2;
+    spsc_produce(&wave_co2_queue);
+    display_frame_request();
+}
+
+/*
+ * Listeners run in the publisher context. Each channel has a single
+ * publisher: the PPG blocks come from the MAX30102 trigger and the raw
+ * CO2 from the STC31 measurement callback, which co2_init() moves to
+ * the acquisition queue with stc31_work_queue_set(). So every queue
+ * keeps a single producer.
+ */
+static void wave_chan_cb(const struct zbus_channel *chan)
+{
+    if (chan == &ppg_block_chan)
+    {
+        const struct ppg_block_msg *msg = zbus_chan_const_msg(chan);
+
+        wave_ppg_add(msg->block->ir, msg->block->count);
+    }
+    else if (chan == &co2_raw_chan)
+    {
+        const struct co2_raw_msg *msg = zbus_chan_const_msg(chan);
+
+        wave_co2_add(msg->co2);
+    }
+}
+
+ZBUS_LISTENER_DEFINE(wave_lis, wave_chan_cb);
+
+ZBUS_CHAN_ADD_OBS(ppg_block_chan, wave_lis, 0);
+ZBUS_CHAN_ADD_OBS(co2_raw_chan, wave_lis, 0);
+
+static lv_obj_t *wave_chart_create(lv_obj_t *parent, lv_coord_t y, lv_coord_t min, lv_coord_t max,
+    lv_chart_series_t **series)
+{
+    lv_obj_t *chart = lv_chart_create(parent);
+
+    lv_obj_set_size(chart, WAVE_POINTS, WAVE_CHART_HEIGHT);
+    lv_obj_align(chart, LV_ALIGN_TOP_LEFT, 0, y);
+    lv_obj_set_style_border_width(chart, 0, LV_PART_MAIN);
+    lv_obj_set_style_pad_all(chart, 0, LV_PART_MAIN);
+    lv_obj_set_style_radius(chart, 0, LV_PART_MAIN);
+    /* Plain line, no point markers */
+    lv_obj_set_style_size(chart, 0, LV_PART_INDICATOR);
+
+    lv_chart_set_type(chart, LV_CHART_TYPE_LINE);
+    lv_chart_set_div_line_count(chart, 0, 0);
+    lv_chart_set_point_count(chart, WAVE_POINTS);
+    lv_chart_set_range(chart, LV_CHART_AXIS_PRIMARY_Y, min, max);
+
+    /* A new point replaces the oldest one in place, so only the columns
+     * around it are invalidated instead of shifting the whole plot.
+     */
+    lv_chart_set_update_mode(chart, LV_CHART_UPDATE_MODE_CIRCULAR);
+
+    /* Draw the line in the text color of the theme, like the labels */
+    *series = lv_chart_add_series(chart, lv_obj_get_style_text_color(chart, LV_PART_MAIN),
+        LV_CHART_AXIS_PRIMARY_Y);
+    lv_chart_set_all_value(chart, *series, LV_CHART_POINT_NONE);
+
+    return chart;
+}
+
+void wave_init(lv_obj_t *parent)
+{
+    wave.ppg_chart = wave_chart_create(parent, WAVE_PPG_OFFSET_Y, -WAVE_PPG_RANGE, WAVE_PPG_RANGE,
+        &wave.ppg_series);
+    wave.co2_chart = wave_chart_create(parent, WAVE_CO2_OFFSET_Y, 0, WAVE_CO2_FULL_SCALE,
+        &wave.co2_series);
+}
+
+/* Remove the DC level and scale the pulse to the recent amplitude */
+static lv_coord_t wave_ppg_scale(int32_t ir)
+{
+    int32_t ac;
+
+    if (!wave.dc_valid)
+    {
+        wave.dc_q8 = ir << 8;
+        wave.dc_valid = true;
+    }
+
+    wave.dc_q8 += ((ir << 8) - wave.dc_q8) >> WAVE_DC_SHIFT;
+
+    /* Blood volume increases absorption, inverting makes the pulse rise */
+    ac = (wave.dc_q8 >> 8) - ir;
+
+    wave.envelope -= wave.envelope >> WAVE_ENVELOPE_SHIFT;
+    wave.envelope = MAX(wave.envelope, MAX(abs(ac), 1));
+
+    return (lv_coord_t)CLAMP((ac * WAVE_PPG_RANGE) / wave.envelope, -WAVE_PPG_RANGE, WAVE_PPG_RANGE);
+}
+
+void wave_render(void)
+{
+    uint32_t dropped = (uint32_t)atomic_get(&wave.dropped);
+    int32_t *ppg;
+    uint16_t *co2;
+
+    if (wave.ppg_chart == NULL)
+    {
+        return;
+    }
+
+    while ((ppg = spsc_consume(&wave_ppg_queue)) != NULL)
+    {
+        lv_chart_set_next_value(wave.ppg_chart, wave.ppg_series, wave_ppg_scale(*ppg));
+        spsc_release(&wave_ppg_queue);
+    }
+
+    while ((co2 = spsc_consume(&wave_co2_queue)) != NULL)
+    {
+        lv_chart_set_next_value(wave.co2_chart, wave.co2_series, MIN(*co2, WAVE_CO2_FULL_SCALE));
+        spsc_release(&wave_co2_queue);
+    }
+
+    if (dropped != wave.dropped_reported)
+    {
+        LOG_WRN("%u waveform points dropped", dropped - wave.dropped_reported);
+        wave.dropped_reported = dropped;
+    }
+}
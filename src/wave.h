@@ -0,0 +1,19 @@
+#ifndef WAVE_H
+#define WAVE_H
+
+#include <lvgl.h>
+
+/*
+ * Scrolling IR PPG and capnogram plots. The PPG block and raw CO2
+ * channel listeners only decimate the samples and push them to a
+ * lock-free single producer, single consumer queue; the UI drains the
+ * queues and appends one chart point per sample, so a frame redraws the
+ * new columns only.
+ */
+
+/* The functions below run in the LVGL context */
+void wave_init(lv_obj_t *parent);
+
+void wave_render(void);
+
+#endif /* WAVE_H */
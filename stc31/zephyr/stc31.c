@@ -4,7 +4,7 @@
 
 #define DT_DRV_COMPAT sensirion_stc31
 
-#define STC31_MEASUREMENT_READOUT_ATTEMPTS 10
+#include <stdlib.h>
 
 #include "zephyr/logging/log.h"
 
@@ -12,9 +12,82 @@
 
 LOG_MODULE_REGISTER(STC31, CONFIG_SENSOR_LOG_LEVEL);
 
-static uint8_t compute_crc(uint8_t data[], uint8_t len)
+#define STC31_CRC_INIT    0xFF
+
+#if defined(CONFIG_STC31_CRC_TABLE)
+/* CRC-8 of every byte value, polynomial 0x31 */
+static const uint8_t stc31_crc_table[256] =
+{
+    0x00, 0x31, 0x62, 0x53, 0xc4, 0xf5, 0xa6, 0x97,
+    0xb9, 0x88, 0xdb, 0xea, 0x7d, 0x4c, 0x1f, 0x2e,
+    0x43, 0x72, 0x21, 0x10, 0x87, 0xb6, 0xe5, 0xd4,
+    0xfa, 0xcb, 0x98, 0xa9, 0x3e, 0x0f, 0x5c, 0x6d,
+    0x86, 0xb7, 0xe4, 0xd5, 0x42, 0x73, 0x20, 0x11,
+    0x3f, 0x0e, 0x5d, 0x6c, 0xfb, 0xca, 0x99, 0xa8,
+    0xc5, 0xf4, 0xa7, 0x96, 0x01, 0x30, 0x63, 0x52,
+    0x7c, 0x4d, 0x1e, 0x2f, 0xb8, 0x89, 0xda, 0xeb,
+    0x3d, 0x0c, 0x5f, 0x6e, 0xf9, 0xc8, 0x9b, 0xaa,
+    0x84, 0xb5, 0xe6, 0xd7, 0x40, 0x71, 0x22, 0x13,
+    0x7e, 0x4f, 0x1c, 0x2d, 0xba, 0x8b, 0xd8, 0xe9,
+    0xc7, 0xf6, 0xa5, 0x94, 0x03, 0x32, 0x61, 0x50,
+    0xbb, 0x8a, 0xd9, 0xe8, 0x7f, 0x4e, 0x1d, 0x2c,
+    0x02, 0x33, 0x60, 0x51, 0xc6, 0xf7, 0xa4, 0x95,
+    0xf8, 0xc9, 0x9a, 0xab, 0x3c, 0x0d, 0x5e, 0x6f,
+    0x41, 0x70, 0x23, 0x12, 0x85, 0xb4, 0xe7, 0xd6,
+    0x7a, 0x4b, 0x18, 0x29, 0xbe, 0x8f, 0xdc, 0xed,
+    0xc3, 0xf2, 0xa1, 0x90, 0x07, 0x36, 0x65, 0x54,
+    0x39, 0x08, 0x5b, 0x6a, 0xfd, 0xcc, 0x9f, 0xae,
+    0x80, 0xb1, 0xe2, 0xd3, 0x44, 0x75, 0x26, 0x17,
+    0xfc, 0xcd, 0x9e, 0xaf, 0x38, 0x09, 0x5a, 0x6b,
+    0x45, 0x74, 0x27, 0x16, 0x81, 0xb0, 0xe3, 0xd2,
+    0xbf, 0x8e, 0xdd, 0xec, 0x7b, 0x4a, 0x19, 0x28,
+    0x06, 0x37, 0x64, 0x55, 0xc2, 0xf3, 0xa0, 0x91,
+    0x47, 0x76, 0x25, 0x14, 0x83, 0xb2, 0xe1, 0xd0,
+    0xfe, 0xcf, 0x9c, 0xad, 0x3a, 0x0b, 0x58, 0x69,
+    0x04, 0x35, 0x66, 0x57, 0xc0, 0xf1, 0xa2, 0x93,
+    0xbd, 0x8c, 0xdf, 0xee, 0x79, 0x48, 0x1b, 0x2a,
+    0xc1, 0xf0, 0xa3, 0x92, 0x05, 0x34, 0x67, 0x56,
+    0x78, 0x49, 0x1a, 0x2b, 0xbc, 0x8d, 0xde, 0xef,
+    0x82, 0xb3, 0xe0, 0xd1, 0x46, 0x77, 0x24, 0x15,
+    0x3b, 0x0a, 0x59, 0x68, 0xff, 0xce, 0x9d, 0xac,
+};
+
+uint8_t stc31_compute_crc(uint8_t data[], uint8_t len)
+{
+    uint8_t crc = STC31_CRC_INIT;
+
+    for (uint8_t i = 0; i < len; i++)
+    {
+        crc = stc31_crc_table[crc ^ data[i]];
+    }
+
+    return crc;
+}
+#elif defined(CONFIG_STC31_CRC_NIBBLE)
+/* CRC-8 of every high nibble value, polynomial 0x31 */
+static const uint8_t stc31_crc_table[16] =
 {
-    uint8_t crc = 0xFF;
+    0x00, 0x31, 0x62, 0x53, 0xc4, 0xf5, 0xa6, 0x97,
+    0xb9, 0x88, 0xdb, 0xea, 0x7d, 0x4c, 0x1f, 0x2e,
+};
+
+uint8_t stc31_compute_crc(uint8_t data[], uint8_t len)
+{
+    uint8_t crc = STC31_CRC_INIT;
+
+    for (uint8_t i = 0; i < len; i++)
+    {
+        crc ^= data[i];
+        crc = (uint8_t)(crc << 4) ^ stc31_crc_table[crc >> 4];
+        crc = (uint8_t)(crc << 4) ^ stc31_crc_table[crc >> 4];
+    }
+
+    return crc;
+}
+#else
+uint8_t stc31_compute_crc(uint8_t data[], uint8_t len)
+{
+    uint8_t crc = STC31_CRC_INIT;
 
     for (uint8_t i = 0; i < len; i++)
     {
@@ -35,53 +108,372 @@ static uint8_t compute_crc(uint8_t data[], uint8_t len)
 
     return crc;
 }
+#endif
 
-static int stc31_sample_fetch(const struct device *dev, enum sensor_channel chan)
+/* All the sensor traffic goes through these helpers, so it can be counted */
+static int stc31_write(const struct device *dev, const uint8_t *buf, uint32_t num_bytes)
 {
+    const struct stc31_config *config = dev->config;
     struct stc31_data *data = dev->data;
+
+    data->i2c_transactions++;
+
+    return i2c_write_dt(&config->i2c, buf, num_bytes);
+}
+
+static int stc31_read(const struct device *dev, uint8_t *buf, uint32_t num_bytes)
+{
     const struct stc31_config *config = dev->config;
+    struct stc31_data *data = dev->data;
+
+    data->i2c_transactions++;
+
+    return i2c_read_dt(&config->i2c, buf, num_bytes);
+}
+
+static int stc31_write_read(const struct device *dev, const uint8_t *write_buf, size_t num_write,
+    uint8_t *read_buf, size_t num_read)
+{
+    const struct stc31_config *config = dev->config;
+    struct stc31_data *data = dev->data;
+
+    data->i2c_transactions++;
+
+    return i2c_write_read_dt(&config->i2c, write_buf, num_write, read_buf, num_read);
+}
+
+uint32_t stc31_i2c_transactions_get(const struct device *dev)
+{
+    struct stc31_data *data = dev->data;
+
+    return data->i2c_transactions;
+}
+
+/*
+ * Extract the words of a readout, each followed by its CRC. Every word is
+ * checked, so a corrupted word in a long readout is never used.
+ */
+static int stc31_words_unpack(const uint8_t *buffer, uint16_t *words, size_t num_words)
+{
+    for (size_t i = 0; i < num_words; i++)
+    {
+        const uint8_t *word = &buffer[i * STC31_WORD_SIZE];
+
+        if (stc31_compute_crc((uint8_t *)word, 2) != word[2])
+        {
+            LOG_ERR("Measured and computed CRCs do not match in word %u", (uint32_t)i);
+            return -EIO;
+        }
+
+        words[i] = ((uint16_t)word[0] << 8) | word[1];
+    }
+
+    return 0;
+}
+
+/* Commands and change thresholds of the compensation inputs, in sensor ticks */
+static const uint16_t stc31_comp_cmd[STC31_COMP_TOP] =
+{
+    [STC31_COMP_HUMIDITY] = STC31_CMD_SET_RELATIVE_HUMIDITY,
+    [STC31_COMP_TEMPERATURE] = STC31_CMD_SET_TEMPERATURE,
+    [STC31_COMP_PRESSURE] = STC31_CMD_SET_PRESSURE,
+};
+
+static const uint16_t stc31_comp_threshold[STC31_COMP_TOP] =
+{
+    [STC31_COMP_HUMIDITY] = (CONFIG_STC31_COMP_HUMIDITY_THRESHOLD * 65535) / 100,
+    [STC31_COMP_TEMPERATURE] = CONFIG_STC31_COMP_TEMPERATURE_THRESHOLD * 20,
+    [STC31_COMP_PRESSURE] = CONFIG_STC31_COMP_PRESSURE_THRESHOLD,
+};
+
+static void stc31_comp_set(struct stc31_data *data, enum stc31_comp_input input, uint16_t value)
+{
+    struct stc31_comp *comp = &data->comp[input];
+    int32_t delta = (input == STC31_COMP_TEMPERATURE) ? ((int16_t)value - (int16_t)comp->sent) :
+                                                        (value - comp->sent);
+
+    comp->value = value;
+
+    /* Small changes are kept back, they are sent along with the next large one */
+    if (!comp->valid || (abs(delta) > stc31_comp_threshold[input]))
+    {
+        comp->dirty = true;
+    }
+}
+
+static int stc31_comp_flush(const struct device *dev)
+{
+    struct stc31_data *data = dev->data;
+
+    for (int i = 0; i < STC31_COMP_TOP; i++)
+    {
+        struct stc31_comp *comp = &data->comp[i];
+        uint8_t buffer[5] = {stc31_comp_cmd[i] >> 8,
+                             (uint8_t)stc31_comp_cmd[i],
+                             comp->value >> 8,
+                             (uint8_t)comp->value};
+
+        if (!comp->dirty)
+        {
+            continue;
+        }
+
+        buffer[4] = stc31_compute_crc(&buffer[2], 2);
+
+        if (stc31_write(dev, buffer, sizeof(buffer)))
+        {
+            LOG_ERR("Could not set compensation input %d", i);
+            return -EIO;
+        }
+
+        LOG_DBG("Compensation input %d set to %d", i, comp->value);
+
+        comp->sent = comp->value;
+        comp->valid = true;
+        comp->dirty = false;
+    }
+
+    return 0;
+}
+
+int stc31_measurement_trigger(const struct device *dev)
+{
+    if (stc31_comp_flush(dev))
+    {
+        return -EIO;
+    }
 
     uint8_t write_buffer[2] = {STC31_CMD_MEASURE_GAS_CONCENTRATION >> 8,
                                (uint8_t)STC31_CMD_MEASURE_GAS_CONCENTRATION};
 
-    if (i2c_write_dt(&config->i2c, write_buffer, sizeof(write_buffer)))
+    if (stc31_write(dev, write_buffer, sizeof(write_buffer)))
     {
         LOG_ERR("Could not start measuring");
+        return -EIO;
+    }
+
+    return 0;
+}
+
+int stc31_measurement_read(const struct device *dev)
+{
+    struct stc31_data *data = dev->data;
+    uint8_t read_buffer[STC31_WORD_SIZE] = {0};
+
+    /* The sensor does not acknowledge the read until the result is ready */
+    if (stc31_read(dev, read_buffer, sizeof(read_buffer)))
+    {
+        return -EAGAIN;
+    }
+
+    if (stc31_words_unpack(read_buffer, &data->raw, 1))
+    {
+        return -EIO;
     }
 
-    uint8_t read_buffer[3] = {0};
-    uint8_t crc = 0;
+    LOG_DBG("Measurement result: %d", data->raw);
 
+    return 0;
+}
+
+int stc31_sleep(const struct device *dev)
+{
+    struct stc31_data *data = dev->data;
+    uint8_t write_buffer[2] = {STC31_CMD_ENTER_SLEEP_MODE >> 8, (uint8_t)STC31_CMD_ENTER_SLEEP_MODE};
+
+    if (data->sleeping)
+    {
+        return 0;
+    }
+
+    if (data->measurement_cb != NULL)
+    {
+        return -EBUSY;
+    }
+
+    if (stc31_write(dev, write_buffer, sizeof(write_buffer)))
+    {
+        LOG_ERR("Could not enter sleep mode");
+        return -EIO;
+    }
+
+    data->sleeping = true;
+
+    return 0;
+}
+
+/*
+ * Sending its address with the write bit wakes the sensor up, a read
+ * header does not. It does not acknowledge the address until it is awake,
+ * so the outcome of this empty write is irrelevant. Returns true when the
+ * caller has to wait STC31_WAKE_UP_MS.
+ */
+static bool stc31_wake_up(const struct device *dev)
+{
+    struct stc31_data *data = dev->data;
+
+    if (!data->sleeping)
+    {
+        return false;
+    }
+
+    (void)stc31_write(dev, NULL, 0);
+    data->sleeping = false;
+
+    return true;
+}
+
+static void stc31_measurement_work_cb(struct k_work *work)
+{
+    struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+    struct stc31_data *data = CONTAINER_OF(dwork, struct stc31_data, measurement_work);
+    stc31_measurement_cb_t cb = data->measurement_cb;
     int err;
-    int attempts = 0;
-    do {
-        k_sleep(K_MSEC(10));
-        err = i2c_read_dt(&config->i2c, read_buffer, sizeof(read_buffer));
-    } while (err && (attempts++ < STC31_MEASUREMENT_READOUT_ATTEMPTS));
+
+    if (data->waking)
+    {
+        /* The sensor is awake, the measurement itself can start */
+        data->waking = false;
+        err = stc31_measurement_trigger(data->dev);
+        if (err == 0)
+        {
+            k_work_reschedule_for_queue(data->work_q, &data->measurement_work,
+                K_MSEC(STC31_MEASUREMENT_TIME_MS));
+            return;
+        }
+    }
+    else
+    {
+        /* Poll the result without ever sleeping on the work queue */
+        err = stc31_measurement_read(data->dev);
+    }
+
+    if ((err == -EAGAIN) && (data->attempts++ < STC31_MEASUREMENT_READOUT_ATTEMPTS))
+    {
+        k_work_reschedule_for_queue(data->work_q, &data->measurement_work, K_MSEC(STC31_MEASUREMENT_POLL_MS));
+        return;
+    }
 
     if (err)
     {
         LOG_ERR("Could not fetch sample");
-        return -EIO;
+        err = -EIO;
     }
     else
     {
-        LOG_DBG("Sample fetched successfully after %d [ms]", attempts * 10);
+        LOG_DBG("Sample fetched successfully after %d [ms]",
+            STC31_MEASUREMENT_TIME_MS + (data->attempts * STC31_MEASUREMENT_POLL_MS));
     }
 
-    crc = compute_crc(&read_buffer[0], 2);
+    data->measurement_cb = NULL;
+    cb(data->dev, err, data->user_data);
+}
 
-    if (crc == read_buffer[2])
+int stc31_measurement_start(const struct device *dev, stc31_measurement_cb_t cb, void *user_data)
+{
+    struct stc31_data *data = dev->data;
+
+    if (cb == NULL)
     {
-        data->raw = ((uint16_t)read_buffer[0] << 8) | read_buffer[1];
+        return -EINVAL;
     }
-    else
+
+    if (data->measurement_cb != NULL)
+    {
+        return -EBUSY;
+    }
+
+    data->attempts = 0;
+    data->waking = stc31_wake_up(dev);
+
+    if (data->waking)
+    {
+        /* The measurement is started from the work queue once awake */
+        data->measurement_cb = cb;
+        data->user_data = user_data;
+        k_work_schedule_for_queue(data->work_q, &data->measurement_work, K_MSEC(STC31_WAKE_UP_MS));
+        return 0;
+    }
+
+    if (stc31_measurement_trigger(dev))
     {
-        LOG_ERR("Measured and computed CRCs do not match");
         return -EIO;
     }
 
-    LOG_DBG("Measurement result: %d", data->raw);
+    /* The result is read back from the work queue once it is ready, the
+     * first poll is when the datasheet says it should be.
+     */
+    data->measurement_cb = cb;
+    data->user_data = user_data;
+    k_work_schedule_for_queue(data->work_q, &data->measurement_work, K_MSEC(STC31_MEASUREMENT_TIME_MS));
+
+    return 0;
+}
+
+void stc31_work_queue_set(const struct device *dev, struct k_work_q *queue)
+{
+    struct stc31_data *data = dev->data;
+
+    data->work_q = (queue != NULL) ? queue : &k_sys_work_q;
+}
+
+int stc31_asc_state_read(const struct device *dev, uint16_t *state)
+{
+    uint8_t write_buffer[2] = {STC31_CMD_ASC_PREPARE_READ_STATE >> 8,
+                               (uint8_t)STC31_CMD_ASC_PREPARE_READ_STATE};
+    uint8_t read_buffer[STC31_ASC_STATE_WORDS * STC31_WORD_SIZE];
+
+    if (stc31_write(dev, write_buffer, sizeof(write_buffer)))
+    {
+        LOG_ERR("Could not prepare the ASC state readout");
+        return -EIO;
+    }
+
+    write_buffer[0] = STC31_CMD_ASC_READ_STATE >> 8;
+    write_buffer[1] = (uint8_t)STC31_CMD_ASC_READ_STATE;
+
+    if (stc31_write_read(dev, write_buffer, sizeof(write_buffer), read_buffer, sizeof(read_buffer)))
+    {
+        LOG_ERR("Could not read the ASC state");
+        return -EIO;
+    }
+
+    return stc31_words_unpack(read_buffer, state, STC31_ASC_STATE_WORDS);
+}
+
+static int stc31_sample_fetch(const struct device *dev, enum sensor_channel chan)
+{
+    int err;
+    int attempts = 0;
+
+    if (stc31_wake_up(dev))
+    {
+        k_sleep(K_MSEC(STC31_WAKE_UP_MS));
+    }
+
+    if (stc31_measurement_trigger(dev))
+    {
+        return -EIO;
+    }
+
+    k_sleep(K_MSEC(STC31_MEASUREMENT_TIME_MS));
+
+    while (((err = stc31_measurement_read(dev)) == -EAGAIN) &&
+           (attempts++ < STC31_MEASUREMENT_READOUT_ATTEMPTS))
+    {
+        k_sleep(K_MSEC(STC31_MEASUREMENT_POLL_MS));
+    }
+
+    if (err)
+    {
+        LOG_ERR("Could not fetch sample");
+        return -EIO;
+    }
+    else
+    {
+        LOG_DBG("Sample fetched successfully after %d [ms]",
+            STC31_MEASUREMENT_TIME_MS + (attempts * STC31_MEASUREMENT_POLL_MS));
+    }
 
     return 0;
 }
@@ -96,17 +488,78 @@ static int stc31_channel_get(const struct device *dev, enum sensor_channel chan,
     return 0;
 }
 
+static int stc31_attr_set(const struct device *dev, enum sensor_channel chan, enum sensor_attribute attr,
+    const struct sensor_value *val)
+{
+    struct stc31_data *data = dev->data;
+    int64_t micro = sensor_value_to_micro(val);
+
+    if (chan != SENSOR_CHAN_CO2)
+    {
+        LOG_ERR("Not supported channel");
+        return -ENOTSUP;
+    }
+
+    switch ((int)attr)
+    {
+    case SENSOR_ATTR_STC31_RELATIVE_HUMIDITY:
+        /* 0 to 100 % over the full 16 bits */
+        if ((micro < 0) || (micro > (100 * 1000000LL)))
+        {
+            return -EINVAL;
+        }
+        stc31_comp_set(data, STC31_COMP_HUMIDITY, (uint16_t)((micro * 65535) / (100 * 1000000LL)));
+        break;
+
+    case SENSOR_ATTR_STC31_TEMPERATURE:
+        /* Signed ticks of 1/200 degC */
+        if ((micro < -163000000LL) || (micro > 163000000LL))
+        {
+            return -EINVAL;
+        }
+        stc31_comp_set(data, STC31_COMP_TEMPERATURE, (uint16_t)(int16_t)((micro * 200) / 1000000));
+        break;
+
+    case SENSOR_ATTR_STC31_PRESSURE:
+        /* mbar, i.e. 1/10 kPa */
+        if ((micro < 0) || (micro > (6553 * 1000000LL)))
+        {
+            return -EINVAL;
+        }
+        stc31_comp_set(data, STC31_COMP_PRESSURE, (uint16_t)(micro / 100000));
+        break;
+
+    default:
+        return -ENOTSUP;
+    }
+
+    return 0;
+}
+
 static const struct sensor_driver_api stc31_driver_api =
 {
+    .attr_set = stc31_attr_set,
     .sample_fetch = stc31_sample_fetch,
     .channel_get = stc31_channel_get,
+#ifdef CONFIG_SENSOR_ASYNC_API
+    .submit = stc31_submit,
+    .get_decoder = stc31_get_decoder,
+#endif
 };
 
 static int stc31_init(const struct device *dev)
 {
     const struct stc31_config *config = dev->config;
+    struct stc31_data *data = dev->data;
     uint32_t part_id;
 
+    data->dev = dev;
+    data->work_q = &k_sys_work_q;
+    k_work_init_delayable(&data->measurement_work, stc31_measurement_work_cb);
+#ifdef CONFIG_SENSOR_ASYNC_API
+    k_work_init(&data->submit_work, stc31_submit_work_cb);
+#endif
+
     if (!device_is_ready(config->i2c.bus)) {
         LOG_ERR("Bus device is not ready");
         return -ENODEV;
@@ -115,7 +568,7 @@ static int stc31_init(const struct device *dev)
     uint8_t write_buffer[2] = {STC31_CMD_READ_PRODUCT_IDENTIFIER_1 >> 8,
                                (uint8_t)STC31_CMD_READ_PRODUCT_IDENTIFIER_1};
 
-    if (i2c_write_dt(&config->i2c, write_buffer, sizeof(write_buffer)))
+    if (stc31_write(dev, write_buffer, sizeof(write_buffer)))
     {
         LOG_ERR("Could not write product identifier command code");
 
@@ -125,7 +578,7 @@ static int stc31_init(const struct device *dev)
             LOG_ERR("Bus recovery failed");
             return -EIO;
         }
-        if (i2c_write_dt(&config->i2c, write_buffer, sizeof(write_buffer)))
+        if (stc31_write(dev, write_buffer, sizeof(write_buffer)))
         {
             LOG_ERR("Attempt to recover the bus failed");
             return -EIO;
@@ -135,16 +588,18 @@ static int stc31_init(const struct device *dev)
     write_buffer[0] = STC31_CMD_READ_PRODUCT_IDENTIFIER_2 >> 8;
     write_buffer[1] = (uint8_t)STC31_CMD_READ_PRODUCT_IDENTIFIER_2;
 
-    uint8_t read_buffer[5] = {0};
+    uint8_t read_buffer[2 * STC31_WORD_SIZE] = {0};
+    uint16_t product_id[2];
 
     /* Check the part id to make sure this is STC31 */
-    if (i2c_write_read_dt(&config->i2c, write_buffer, sizeof(write_buffer), read_buffer, sizeof(read_buffer)))
+    if (stc31_write_read(dev, write_buffer, sizeof(write_buffer), read_buffer, sizeof(read_buffer)) ||
+        stc31_words_unpack(read_buffer, product_id, ARRAY_SIZE(product_id)))
     {
         LOG_ERR("Could not get Part ID");
         return -EIO;
     }
 
-    part_id = (read_buffer[0] << 24) | (read_buffer[1] << 16) | (read_buffer[3] << 8) | read_buffer[4];
+    part_id = ((uint32_t)product_id[0] << 16) | product_id[1];
 
     if (part_id != STC31_PART_ID)
     {
@@ -158,9 +613,9 @@ static int stc31_init(const struct device *dev)
                          STC31_ARG_CO2_IN_AIR_100 >> 8,
                          (uint8_t)STC31_ARG_CO2_IN_AIR_100};
 
-    buffer[4] = compute_crc(&buffer[2], 2);
+    buffer[4] = stc31_compute_crc(&buffer[2], 2);
 
-    if (i2c_write_dt(&config->i2c, buffer, sizeof(buffer)))
+    if (stc31_write(dev, buffer, sizeof(buffer)))
     {
         LOG_ERR("Could not set binary gas");
         return -EIO;
@@ -173,9 +628,9 @@ static int stc31_init(const struct device *dev)
     buffer[2] = concentration >> 8;
     buffer[3] = (uint8_t)concentration;
 
-    buffer[4] = compute_crc(&buffer[2], 2);
+    buffer[4] = stc31_compute_crc(&buffer[2], 2);
 
-    if (i2c_write_dt(&config->i2c, buffer, sizeof(buffer)))
+    if (stc31_write(dev, buffer, sizeof(buffer)))
     {
         LOG_ERR("Could not force recalibration");
         return -EIO;
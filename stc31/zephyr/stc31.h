@@ -2,6 +2,9 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#ifndef STC31_H
+#define STC31_H
+
 #include <zephyr/drivers/sensor.h>
 #include <zephyr/drivers/i2c.h>
 #include <zephyr/drivers/gpio.h>
@@ -34,12 +37,139 @@
 
 #define STC31_FRC_REFERENCE_CONCENTRATION    0
 
+/* Every word exchanged with the sensor is followed by its CRC */
+#define STC31_WORD_SIZE    3
+
+#define STC31_ASC_STATE_WORDS    10
+
+/* Command durations from the datasheet */
+#define STC31_MEASUREMENT_TIME_MS    66
+#define STC31_WAKE_UP_MS             12
+
+#define STC31_MEASUREMENT_POLL_MS             10
+#define STC31_MEASUREMENT_READOUT_ATTEMPTS    10
+
+/*
+ * Driver specific attributes of SENSOR_CHAN_CO2 setting the compensation
+ * inputs: relative humidity in %, temperature in degC and pressure in kPa,
+ * the units of the matching sensor channels.
+ */
+enum stc31_sensor_attribute
+{
+    SENSOR_ATTR_STC31_RELATIVE_HUMIDITY = SENSOR_ATTR_PRIV_START,
+    SENSOR_ATTR_STC31_TEMPERATURE,
+    SENSOR_ATTR_STC31_PRESSURE,
+};
+
+enum stc31_comp_input
+{
+    STC31_COMP_HUMIDITY,
+    STC31_COMP_TEMPERATURE,
+    STC31_COMP_PRESSURE,
+
+    STC31_COMP_TOP,
+};
+
+/* Compensation input in the sensor format and the value last sent to it */
+struct stc31_comp
+{
+    uint16_t value;
+    uint16_t sent;
+    bool valid;
+    bool dirty;
+};
+
 struct stc31_config
 {
     struct i2c_dt_spec i2c;
 };
 
+/*
+ * Called from the driver work queue, see stc31_work_queue_set(), when a
+ * measurement started with stc31_measurement_start() completes. On
+ * success the result can be read with sensor_channel_get().
+ */
+typedef void (*stc31_measurement_cb_t)(const struct device *dev, int err, void *user_data);
+
 struct stc31_data
 {
     uint16_t raw;
+    const struct device *dev;
+    struct k_work_q *work_q;
+    struct k_work_delayable measurement_work;
+    stc31_measurement_cb_t measurement_cb;
+    void *user_data;
+    int attempts;
+    bool sleeping;
+    bool waking;
+    uint32_t i2c_transactions;
+    struct stc31_comp comp[STC31_COMP_TOP];
+#ifdef CONFIG_SENSOR_ASYNC_API
+    /* Pending asynchronous read, started from work_q */
+    struct k_work submit_work;
+    struct rtio_iodev_sqe *iodev_sqe;
+#endif
+};
+
+/* Frame produced by the asynchronous read API */
+struct stc31_encoded_data
+{
+    uint64_t timestamp;
+    uint16_t raw;
 };
+
+/* CRC-8 protecting every 16-bit word exchanged with the sensor */
+uint8_t stc31_compute_crc(uint8_t data[], uint8_t len);
+
+/*
+ * Start a measurement. The compensation inputs which changed beyond their
+ * threshold since they were last sent are written first.
+ */
+int stc31_measurement_trigger(const struct device *dev);
+
+/*
+ * Read back the result of a triggered measurement. Returns -EAGAIN while
+ * the sensor is still measuring.
+ */
+int stc31_measurement_read(const struct device *dev);
+
+/*
+ * Start a measurement without blocking. The result is polled from a
+ * delayable work item and cb is called once it is available or the
+ * readout failed. Returns -EBUSY while another measurement is pending.
+ */
+int stc31_measurement_start(const struct device *dev, stc31_measurement_cb_t cb, void *user_data);
+
+/*
+ * Run the measurement polling and the completion callback, as well as the
+ * start of the asynchronous reads, on queue instead of the system work
+ * queue. Only call it while no measurement is pending.
+ */
+void stc31_work_queue_set(const struct device *dev, struct k_work_q *queue);
+
+/*
+ * Put the sensor in sleep mode. The next measurement wakes it up first,
+ * which delays the result by STC31_WAKE_UP_MS. Returns -EBUSY while a
+ * measurement is pending.
+ */
+int stc31_sleep(const struct device *dev);
+
+/* Number of I2C transactions addressed to the sensor since boot */
+uint32_t stc31_i2c_transactions_get(const struct device *dev);
+
+/*
+ * Read the automatic self-calibration state, STC31_ASC_STATE_WORDS words,
+ * so that it can be restored after a power cycle. The CRC of every word
+ * is checked.
+ */
+int stc31_asc_state_read(const struct device *dev, uint16_t *state);
+
+#ifdef CONFIG_SENSOR_ASYNC_API
+void stc31_submit(const struct device *dev, struct rtio_iodev_sqe *iodev_sqe);
+
+void stc31_submit_work_cb(struct k_work *work);
+
+int stc31_get_decoder(const struct device *dev, const struct sensor_decoder_api **decoder);
+#endif
+
+#endif /* STC31_H */
@@ -0,0 +1,90 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define DT_DRV_COMPAT sensirion_stc31
+
+#include <zephyr/rtio/rtio.h>
+
+#include "zephyr/logging/log.h"
+
+#include "stc31.h"
+
+LOG_MODULE_DECLARE(STC31, CONFIG_SENSOR_LOG_LEVEL);
+
+static void stc31_async_measurement_done(const struct device *dev, int err, void *user_data)
+{
+    struct rtio_iodev_sqe *iodev_sqe = user_data;
+    struct stc31_data *data = dev->data;
+    struct stc31_encoded_data *edata;
+    uint8_t *buf;
+    uint32_t buf_len;
+
+    /* Cleared first, the completion may already submit the next read */
+    data->iodev_sqe = NULL;
+
+    if (err)
+    {
+        rtio_iodev_sqe_err(iodev_sqe, err);
+        return;
+    }
+
+    err = rtio_sqe_rx_buf(iodev_sqe, sizeof(*edata), sizeof(*edata), &buf, &buf_len);
+    if (err)
+    {
+        LOG_ERR("Failed to get a read buffer of size %u bytes", sizeof(*edata));
+        rtio_iodev_sqe_err(iodev_sqe, err);
+        return;
+    }
+
+    edata = (struct stc31_encoded_data *)buf;
+    edata->timestamp = k_ticks_to_ns_floor64(k_uptime_ticks());
+    edata->raw = data->raw;
+
+    rtio_iodev_sqe_ok(iodev_sqe, 0);
+}
+
+/*
+ * Start the measurement of the pending read. Runs on the driver work
+ * queue, see stc31_work_queue_set(), so that the wake-up and trigger
+ * writes never block the submitter.
+ */
+void stc31_submit_work_cb(struct k_work *work)
+{
+    struct stc31_data *data = CONTAINER_OF(work, struct stc31_data, submit_work);
+    struct rtio_iodev_sqe *iodev_sqe = data->iodev_sqe;
+    int err;
+
+    err = stc31_measurement_start(data->dev, stc31_async_measurement_done, iodev_sqe);
+    if (err)
+    {
+        data->iodev_sqe = NULL;
+        rtio_iodev_sqe_err(iodev_sqe, err);
+    }
+}
+
+void stc31_submit(const struct device *dev, struct rtio_iodev_sqe *iodev_sqe)
+{
+    const struct sensor_read_config *cfg = iodev_sqe->sqe.iodev->data;
+    struct stc31_data *data = dev->data;
+
+    for (size_t i = 0; i < cfg->count; i++)
+    {
+        if ((cfg->channels[i].chan_type != SENSOR_CHAN_CO2) &&
+            (cfg->channels[i].chan_type != SENSOR_CHAN_ALL))
+        {
+            LOG_ERR("Unsupported sensor channel");
+            rtio_iodev_sqe_err(iodev_sqe, -ENOTSUP);
+            return;
+        }
+    }
+
+    if (data->iodev_sqe != NULL)
+    {
+        rtio_iodev_sqe_err(iodev_sqe, -EBUSY);
+        return;
+    }
+
+    data->iodev_sqe = iodev_sqe;
+    k_work_submit_to_queue(data->work_q, &data->submit_work);
+}
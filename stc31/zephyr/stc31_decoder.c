@@ -0,0 +1,85 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define DT_DRV_COMPAT sensirion_stc31
+
+#include "stc31.h"
+
+/* The sensor range of -50 to 150 vol% fits in 2^21 ppm */
+#define STC31_Q31_SHIFT    21
+
+static int stc31_decoder_get_frame_count(const uint8_t *buffer, struct sensor_chan_spec chan_spec,
+    uint16_t *frame_count)
+{
+    ARG_UNUSED(buffer);
+
+    if ((chan_spec.chan_type != SENSOR_CHAN_CO2) || (chan_spec.chan_idx != 0))
+    {
+        return -ENOTSUP;
+    }
+
+    *frame_count = 1;
+
+    return 0;
+}
+
+static int stc31_decoder_get_size_info(struct sensor_chan_spec chan_spec, size_t *base_size, size_t *frame_size)
+{
+    if (chan_spec.chan_type != SENSOR_CHAN_CO2)
+    {
+        return -ENOTSUP;
+    }
+
+    *base_size = sizeof(struct sensor_q31_data);
+    *frame_size = sizeof(struct sensor_q31_sample_data);
+
+    return 0;
+}
+
+static int stc31_decoder_decode(const uint8_t *buffer, struct sensor_chan_spec chan_spec, uint32_t *fit,
+    uint16_t max_count, void *data_out)
+{
+    const struct stc31_encoded_data *edata = (const struct stc31_encoded_data *)buffer;
+    struct sensor_q31_data *out = data_out;
+
+    if ((chan_spec.chan_type != SENSOR_CHAN_CO2) || (chan_spec.chan_idx != 0))
+    {
+        return -ENOTSUP;
+    }
+
+    if ((*fit != 0) || (max_count == 0))
+    {
+        return 0;
+    }
+
+    /*
+     * ppm = (raw - 16384) * 100 / 32768 * 10000, scaled by 2^(31 - shift)
+     * which reduces to an exact integer multiplication.
+     */
+    out->header.base_timestamp_ns = edata->timestamp;
+    out->header.reading_count = 1;
+    out->shift = STC31_Q31_SHIFT;
+    out->readings[0].timestamp_delta = 0;
+    out->readings[0].value = ((int32_t)edata->raw - 16384) * 31250;
+
+    *fit = 1;
+
+    return 1;
+}
+
+SENSOR_DECODER_API_DT_DEFINE() =
+{
+    .get_frame_count = stc31_decoder_get_frame_count,
+    .get_size_info = stc31_decoder_get_size_info,
+    .decode = stc31_decoder_decode,
+};
+
+int stc31_get_decoder(const struct device *dev, const struct sensor_decoder_api **decoder)
+{
+    ARG_UNUSED(dev);
+
+    *decoder = &SENSOR_DECODER_NAME();
+
+    return 0;
+}
@@ -0,0 +1,403 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define DT_DRV_COMPAT sensirion_stc31
+
+#include <string.h>
+
+#include <zephyr/device.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/drivers/i2c.h>
+#include <zephyr/drivers/i2c_emul.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/util.h>
+
+#include "zephyr/logging/log.h"
+
+#include "stc31.h"
+#include "stc31_emul.h"
+
+LOG_MODULE_REGISTER(stc31_emul, CONFIG_SENSOR_LOG_LEVEL);
+
+#define STC31_EMUL_MAX_WORDS    STC31_ASC_STATE_WORDS
+
+/* Command execution times from the datasheet */
+#define STC31_EMUL_MEASURE_MS      66
+#define STC31_EMUL_SELF_TEST_MS    22
+#define STC31_EMUL_WAKE_UP_MS      12
+
+#define STC31_EMUL_PRODUCT_ID_1    (STC31_PART_ID >> 16)
+#define STC31_EMUL_PRODUCT_ID_2    (STC31_PART_ID & 0xffff)
+
+#define STC31_EMUL_DEFAULT_BREATHS_PER_MIN    15
+#define STC31_EMUL_DEFAULT_ETCO2              500
+
+/* Inspired CO2 in 1/100 vol% */
+#define STC31_EMUL_BASELINE    4
+
+/* Temperature in 1/200 degC used until the host sets one */
+#define STC31_EMUL_DEFAULT_TEMP    (25 * 200)
+
+struct stc31_emul_data
+{
+    struct k_spinlock lock;
+    uint16_t response[STC31_EMUL_MAX_WORDS];
+    uint8_t response_len;
+    int64_t ready_at;
+    int64_t wake_at;
+    bool sleeping;
+    bool crc_enabled;
+    bool asc_enabled;
+    uint16_t binary_gas;
+    uint16_t humidity;
+    uint16_t temperature;
+    uint16_t pressure;
+    uint16_t frc;
+    uint16_t asc_state[STC31_EMUL_MAX_WORDS];
+    /* Word of the next readout sent with a wrong CRC, -1 for none */
+    int16_t corrupt_word;
+    /* Synthetic capnogram */
+    uint8_t breaths_per_min;
+    uint16_t etco2;
+    /* Playback of a recording */
+    const uint16_t *play_ticks;
+    size_t play_len;
+    size_t play_pos;
+};
+
+static void stc31_emul_reset(struct stc31_emul_data *data)
+{
+    data->response_len = 0;
+    data->ready_at = 0;
+    data->corrupt_word = -1;
+    data->sleeping = false;
+    data->crc_enabled = true;
+    data->asc_enabled = true;
+    data->binary_gas = STC31_ARG_CO2_IN_N2_100;
+    data->humidity = 0;
+    data->temperature = STC31_EMUL_DEFAULT_TEMP;
+    data->pressure = 1013;
+}
+
+/*
+ * CO2 over one breath: inspiration at the baseline, then the expiratory
+ * upstroke and an alveolar plateau slowly rising to the end-tidal value.
+ */
+static uint16_t stc31_emul_capnogram(const struct stc31_emul_data *data, int64_t now)
+{
+    uint32_t period = (60 * MSEC_PER_SEC) / data->breaths_per_min;
+    uint32_t phase = (uint32_t)((now % period) * 1000 / period);
+
+    if (phase < 450)
+    {
+        return STC31_EMUL_BASELINE;
+    }
+
+    if (phase < 550)
+    {
+        return STC31_EMUL_BASELINE + (((phase - 450) * 9 * data->etco2) / 1000);
+    }
+
+    return ((9 * data->etco2) / 10) + (((phase - 550) * data->etco2) / 4500);
+}
+
+static uint16_t stc31_emul_gas_ticks(struct stc31_emul_data *data, int64_t now)
+{
+    uint32_t full_scale = ((data->binary_gas == STC31_ARG_CO2_IN_N2_25) ||
+                           (data->binary_gas == STC31_ARG_CO2_IN_AIR_25)) ? 2500 : 10000;
+    uint16_t ticks;
+
+    if (data->play_len != 0)
+    {
+        ticks = data->play_ticks[data->play_pos];
+        data->play_pos = (data->play_pos + 1) % data->play_len;
+        return ticks;
+    }
+
+    return 16384 + (uint16_t)(((uint32_t)stc31_emul_capnogram(data, now) * 32768) / full_scale);
+}
+
+static void stc31_emul_response_set(struct stc31_emul_data *data, const uint16_t *words, uint8_t len,
+    int64_t ready_at)
+{
+    memcpy(data->response, words, len * sizeof(words[0]));
+    data->response_len = len;
+    data->ready_at = ready_at;
+}
+
+static int stc31_emul_command(struct stc31_emul_data *data, const uint8_t *buf, uint32_t len, int64_t now)
+{
+    uint16_t args[STC31_EMUL_MAX_WORDS];
+    uint8_t num_args;
+    uint16_t cmd;
+
+    if ((len < 2) || (((len - 2) % STC31_WORD_SIZE) != 0) ||
+        (((len - 2) / STC31_WORD_SIZE) > STC31_EMUL_MAX_WORDS))
+    {
+        return -EIO;
+    }
+
+    cmd = sys_get_be16(buf);
+    num_args = (len - 2) / STC31_WORD_SIZE;
+
+    for (uint8_t i = 0; i < num_args; i++)
+    {
+        const uint8_t *word = &buf[2 + (i * STC31_WORD_SIZE)];
+
+        /* A corrupted argument is not acknowledged */
+        if (data->crc_enabled && (stc31_compute_crc((uint8_t *)word, 2) != word[2]))
+        {
+            LOG_WRN("CRC mismatch in argument %u of command 0x%04x", i, cmd);
+            return -EIO;
+        }
+
+        args[i] = sys_get_be16(word);
+    }
+
+    /* A new command discards the result of the previous one */
+    data->response_len = 0;
+
+    switch (cmd)
+    {
+    case STC31_CMD_MEASURE_GAS_CONCENTRATION:
+    {
+        uint16_t result[3] = {stc31_emul_gas_ticks(data, now), data->temperature, 0};
+
+        stc31_emul_response_set(data, result, ARRAY_SIZE(result), now + STC31_EMUL_MEASURE_MS);
+        return 0;
+    }
+
+    case STC31_CMD_READ_PRODUCT_IDENTIFIER_2:
+    {
+        uint16_t id[6] = {STC31_EMUL_PRODUCT_ID_1, STC31_EMUL_PRODUCT_ID_2, 0, 0, 0, 1};
+
+        stc31_emul_response_set(data, id, ARRAY_SIZE(id), now);
+        return 0;
+    }
+
+    case STC31_CMD_SELF_TEST:
+    {
+        uint16_t result = 0;
+
+        stc31_emul_response_set(data, &result, 1, now + STC31_EMUL_SELF_TEST_MS);
+        return 0;
+    }
+
+    case STC31_CMD_ASC_READ_STATE:
+        /* Read and write state share the command code, the arguments tell them apart */
+        if (num_args == 0)
+        {
+            stc31_emul_response_set(data, data->asc_state, STC31_EMUL_MAX_WORDS, now);
+        }
+        else
+        {
+            memcpy(data->asc_state, args, num_args * sizeof(args[0]));
+        }
+        return 0;
+
+    case STC31_CMD_SET_BINARY_GAS:
+    case STC31_CMD_SET_RELATIVE_HUMIDITY:
+    case STC31_CMD_SET_TEMPERATURE:
+    case STC31_CMD_SET_PRESSURE:
+    case STC31_CMD_FRC:
+        if (num_args != 1)
+        {
+            return -EIO;
+        }
+
+        if (cmd == STC31_CMD_SET_BINARY_GAS)
+        {
+            data->binary_gas = args[0];
+        }
+        else if (cmd == STC31_CMD_SET_RELATIVE_HUMIDITY)
+        {
+            data->humidity = args[0];
+        }
+        else if (cmd == STC31_CMD_SET_TEMPERATURE)
+        {
+            data->temperature = args[0];
+        }
+        else if (cmd == STC31_CMD_SET_PRESSURE)
+        {
+            data->pressure = args[0];
+        }
+        else
+        {
+            data->frc = args[0];
+        }
+        return 0;
+
+    case STC31_CMD_READ_PRODUCT_IDENTIFIER_1:
+    case STC31_CMD_ASC_PREPARE_READ_STATE:
+    case STC31_CMD_ASC_APPLY_STATE:
+        return 0;
+
+    case STC31_CMD_ASC_EN:
+    case STC31_CMD_ASC_DIS:
+        data->asc_enabled = (cmd == STC31_CMD_ASC_EN);
+        return 0;
+
+    case STC31_CMD_DISABLE_CRC:
+        data->crc_enabled = false;
+        return 0;
+
+    case STC31_CMD_SOFT_RESET:
+        stc31_emul_reset(data);
+        return 0;
+
+    case STC31_CMD_ENTER_SLEEP_MODE:
+        data->sleeping = true;
+        data->wake_at = 0;
+        return 0;
+
+    default:
+        LOG_WRN("Unsupported command 0x%04x", cmd);
+        return -EIO;
+    }
+}
+
+static int stc31_emul_read(struct stc31_emul_data *data, uint8_t *buf, uint32_t len, int64_t now)
+{
+    uint32_t num_words = DIV_ROUND_UP(len, STC31_WORD_SIZE);
+    uint8_t word[STC31_WORD_SIZE];
+
+    /* The sensor does not acknowledge the read until the result is ready */
+    if ((data->response_len == 0) || (now < data->ready_at) || (num_words > data->response_len))
+    {
+        return -EIO;
+    }
+
+    for (uint32_t i = 0; i < len; i++)
+    {
+        uint32_t idx = i % STC31_WORD_SIZE;
+
+        if (idx == 0)
+        {
+            sys_put_be16(data->response[i / STC31_WORD_SIZE], word);
+            word[2] = stc31_compute_crc(word, 2);
+
+            if ((i / STC31_WORD_SIZE) == data->corrupt_word)
+            {
+                word[2] ^= 0xff;
+            }
+        }
+
+        buf[i] = word[idx];
+    }
+
+    data->corrupt_word = -1;
+
+    return 0;
+}
+
+static int stc31_emul_transfer(const struct emul *target, struct i2c_msg *msgs, int num_msgs, int addr)
+{
+    struct stc31_emul_data *data = target->data;
+    int64_t now = k_uptime_get();
+    k_spinlock_key_t key;
+    int err = 0;
+
+    ARG_UNUSED(addr);
+
+    key = k_spin_lock(&data->lock);
+
+    /* Only its address with the write bit wakes the sensor up from sleep
+     * mode, a read header does not. It does not acknowledge anything until
+     * the wake-up time elapsed.
+     */
+    if (data->sleeping)
+    {
+        if ((data->wake_at == 0) && !(msgs[0].flags & I2C_MSG_READ))
+        {
+            data->wake_at = now + STC31_EMUL_WAKE_UP_MS;
+        }
+
+        if ((data->wake_at == 0) || (now < data->wake_at))
+        {
+            k_spin_unlock(&data->lock, key);
+            return -EIO;
+        }
+
+        data->sleeping = false;
+    }
+
+    for (int i = 0; (i < num_msgs) && (err == 0); i++)
+    {
+        if (msgs[i].flags & I2C_MSG_READ)
+        {
+            err = stc31_emul_read(data, msgs[i].buf, msgs[i].len, now);
+        }
+        else if (msgs[i].len == 0)
+        {
+            /* Only the address, acknowledged once awake */
+            continue;
+        }
+        else
+        {
+            err = stc31_emul_command(data, msgs[i].buf, msgs[i].len, now);
+        }
+    }
+
+    k_spin_unlock(&data->lock, key);
+
+    return err;
+}
+
+void stc31_emul_capnogram_set(const struct emul *target, uint8_t breaths_per_min, uint16_t etco2)
+{
+    struct stc31_emul_data *data = target->data;
+    k_spinlock_key_t key = k_spin_lock(&data->lock);
+
+    data->breaths_per_min = MAX(breaths_per_min, 1);
+    data->etco2 = etco2;
+    data->play_len = 0;
+
+    k_spin_unlock(&data->lock, key);
+}
+
+void stc31_emul_playback_set(const struct emul *target, const uint16_t *ticks, size_t len)
+{
+    struct stc31_emul_data *data = target->data;
+    k_spinlock_key_t key = k_spin_lock(&data->lock);
+
+    data->play_ticks = ticks;
+    data->play_len = (ticks != NULL) ? len : 0;
+    data->play_pos = 0;
+
+    k_spin_unlock(&data->lock, key);
+}
+
+void stc31_emul_crc_corrupt_set(const struct emul *target, uint8_t word)
+{
+    struct stc31_emul_data *data = target->data;
+    k_spinlock_key_t key = k_spin_lock(&data->lock);
+
+    data->corrupt_word = word;
+
+    k_spin_unlock(&data->lock, key);
+}
+
+static int stc31_emul_init(const struct emul *target, const struct device *parent)
+{
+    struct stc31_emul_data *data = target->data;
+
+    ARG_UNUSED(parent);
+
+    stc31_emul_reset(data);
+    stc31_emul_capnogram_set(target, STC31_EMUL_DEFAULT_BREATHS_PER_MIN, STC31_EMUL_DEFAULT_ETCO2);
+
+    return 0;
+}
+
+static const struct i2c_emul_api stc31_emul_api_i2c =
+{
+    .transfer = stc31_emul_transfer,
+};
+
+#define STC31_EMUL(n)                                                           \
+    static struct stc31_emul_data stc31_emul_data_##n;                          \
+    EMUL_DT_INST_DEFINE(n, stc31_emul_init, &stc31_emul_data_##n, NULL,         \
+        &stc31_emul_api_i2c, NULL)
+
+DT_INST_FOREACH_STATUS_OKAY(STC31_EMUL)
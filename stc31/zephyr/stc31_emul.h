@@ -0,0 +1,29 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef STC31_EMUL_H
+#define STC31_EMUL_H
+
+#include <zephyr/drivers/emul.h>
+
+/*
+ * Generate a synthetic capnogram with the given respiratory rate and
+ * end-tidal CO2 in 1/100 vol%.
+ */
+void stc31_emul_capnogram_set(const struct emul *target, uint8_t breaths_per_min, uint16_t etco2);
+
+/*
+ * Play back recorded gas ticks instead of the synthetic capnogram, one per
+ * measurement. The recording is looped and must stay valid until playback
+ * is stopped by passing len 0.
+ */
+void stc31_emul_playback_set(const struct emul *target, const uint16_t *ticks, size_t len);
+
+/*
+ * Corrupt the CRC of the given word in the next readout, to exercise the
+ * CRC check of the driver.
+ */
+void stc31_emul_crc_corrupt_set(const struct emul *target, uint8_t word);
+
+#endif /* STC31_EMUL_H */
@@ -0,0 +1,350 @@
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/timing/timing.h>
+
+#include "max30102.h"
+#include "stc31.h"
+
+#include "co2.h"
+#include "hr.h"
+#include "spo2_filter.h"
+#include "spo2_window.h"
+
+#define BENCH_BATCH       MAX30102_FIFO_DEPTH
+#define BENCH_CRC_WORDS   32
+
+/* Synthetic PPG: 72 bpm at 100 Hz, 2 % IR and 1.46 % red perfusion */
+#define BENCH_PPG_PERIOD    83
+#define BENCH_IR_DC         100000
+#define BENCH_RED_DC        50000
+
+struct bench_case
+{
+    const char *name;
+    const char *unit;
+    uint32_t units_per_call;
+    void (*setup)(void);
+    void (*run)(void);
+};
+
+struct bench_ctx
+{
+    uint32_t red[SPO2_WINDOW_SIZE];
+    uint32_t ir[SPO2_WINDOW_SIZE];
+    uint8_t fifo_buf[BENCH_BATCH * MAX30102_MAX_BYTES_PER_SAMPLE];
+    uint32_t fifo_red[BENCH_BATCH];
+    uint32_t fifo_ir[BENCH_BATCH];
+    int32_t out[BENCH_BATCH];
+    uint8_t crc_buf[BENCH_CRC_WORDS * 2];
+    uint8_t crc;
+    float co2;
+    struct spo2_window window;
+    struct spo2_filter filter;
+    struct hr_detector hr;
+    uint8_t spo2;
+};
+
+static struct bench_ctx bench;
+
+/* Asymmetric triangle pulse of about 1000 peak to peak */
+static int32_t bench_pulse(uint32_t i)
+{
+    int32_t phase = (int32_t)(i % BENCH_PPG_PERIOD);
+
+    return ((phase < (BENCH_PPG_PERIOD / 3)) ? (phase * 3000) : ((BENCH_PPG_PERIOD - phase) * 1500)) /
+           BENCH_PPG_PERIOD - 500;
+}
+
+static void bench_fifo_unpack(void)
+{
+    uint32_t *const dest[MAX30102_MAX_NUM_CHANNELS] = {bench.fifo_red, bench.fifo_ir};
+
+    max30102_fifo_unpack(bench.fifo_buf, MAX30102_MAX_NUM_CHANNELS, dest, BENCH_BATCH);
+}
+
+static void bench_window_setup(void)
+{
+    spo2_window_reset(&bench.window);
+}
+
+static void bench_window_add(void)
+{
+    for (uint32_t i = 0; i < SPO2_WINDOW_SIZE; i++)
+    {
+        spo2_window_add(&bench.window, bench.red[i], bench.ir[i]);
+    }
+}
+
+static void bench_window_fill(void)
+{
+    spo2_window_reset(&bench.window);
+    bench_window_add();
+}
+
+/* The path of spo2_calculate(), selected by APP_SPO2_FIXED_POINT */
+static void bench_spo2(void)
+{
+    bench.spo2 = spo2_window_calculate(&bench.window, &bench.window);
+}
+
+static void bench_spo2_fixed(void)
+{
+    bench.spo2 = spo2_window_calculate_fixed(&bench.window, &bench.window);
+}
+
+static void bench_spo2_float(void)
+{
+    bench.spo2 = spo2_window_calculate_float(&bench.window, &bench.window);
+}
+
+static void bench_filter_setup(void)
+{
+    spo2_filter_init(&bench.filter);
+}
+
+static void bench_filter(void)
+{
+    spo2_filter_process(&bench.filter, bench.ir, bench.out, BENCH_BATCH);
+}
+
+static void bench_hr_setup(void)
+{
+    hr_reset(&bench.hr);
+}
+
+static void bench_hr(void)
+{
+    for (uint32_t i = 0; i < BENCH_BATCH; i++)
+    {
+        hr_sample_add(&bench.hr, bench.ir[i]);
+    }
+}
+
+static void bench_co2(void)
+{
+    for (uint32_t i = 0; i < BENCH_BATCH; i++)
+    {
+        bench.co2 = co2_calculate((uint16_t)(16384 + (i * 512)));
+    }
+}
+
+/* Bitwise reference of the CRC selected in the STC31 driver */
+static uint8_t bench_crc_bitwise_word(const uint8_t *data)
+{
+    uint8_t crc = 0xFF;
+
+    for (int i = 0; i < 2; i++)
+    {
+        crc ^= data[i];
+
+        for (int j = 0; j < 8; j++)
+        {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x31) : (uint8_t)(crc << 1);
+        }
+    }
+
+    return crc;
+}
+
+static void bench_crc_bitwise(void)
+{
+    for (uint32_t i = 0; i < BENCH_CRC_WORDS; i++)
+    {
+        bench.crc = bench_crc_bitwise_word(&bench.crc_buf[i * 2]);
+    }
+}
+
+static void bench_crc(void)
+{
+    for (uint32_t i = 0; i < BENCH_CRC_WORDS; i++)
+    {
+        bench.crc = stc31_compute_crc(&bench.crc_buf[i * 2], 2);
+    }
+}
+
+#ifdef CONFIG_BENCHMARK_TIMING
+static uint32_t bench_cycles_per_sec(void)
+{
+    return (uint32_t)timing_freq_get();
+}
+
+static uint32_t bench_call_cycles(void (*run)(void))
+{
+    timing_t start = timing_counter_get();
+
+    run();
+
+    timing_t end = timing_counter_get();
+
+    return (uint32_t)timing_cycles_get(&start, &end);
+}
+#else
+static uint32_t bench_cycles_per_sec(void)
+{
+    return (uint32_t)sys_clock_hw_cycles_per_sec();
+}
+
+static uint32_t bench_call_cycles(void (*run)(void))
+{
+    uint32_t start = k_cycle_get_32();
+
+    run();
+
+    return k_cycle_get_32() - start;
+}
+#endif
+
+/*
+ * Time CONFIG_BENCHMARK_ITERATIONS calls and print one JSON line with the
+ * min, mean and max cycles per call, the cycles per sample, word or window
+ * and the stack high-water mark. ztest runs every test in a new thread, so
+ * the painted stack only holds the usage of this case.
+ */
+static void bench_case_run(const struct bench_case *bc)
+{
+    uint32_t cycles_min = UINT32_MAX;
+    uint32_t cycles_max = 0;
+    uint64_t cycles_sum = 0;
+    size_t unused = 0;
+
+    if (bc->setup != NULL)
+    {
+        bc->setup();
+    }
+
+    for (int i = 0; i < CONFIG_BENCHMARK_ITERATIONS; i++)
+    {
+        uint32_t cycles = bench_call_cycles(bc->run);
+
+        cycles_min = MIN(cycles_min, cycles);
+        cycles_max = MAX(cycles_max, cycles);
+        cycles_sum += cycles;
+    }
+
+    zassert_ok(k_thread_stack_space_get(k_current_get(), &unused), "Stack usage of %s is not available",
+        bc->name);
+
+    uint32_t cycles_avg = (uint32_t)(cycles_sum / CONFIG_BENCHMARK_ITERATIONS);
+
+    TC_PRINT("{\"bench\":\"%s\",\"cycles_min\":%u,\"cycles_avg\":%u,\"cycles_max\":%u,"
+             "\"unit\":\"%s\",\"cycles_per_%s\":%u,\"stack_bytes\":%u}\n",
+        bc->name, cycles_min, cycles_avg, cycles_max, bc->unit, bc->unit, cycles_avg / bc->units_per_call,
+        (uint32_t)(k_current_get()->stack_info.size - unused));
+}
+
+static void *bench_setup(void)
+{
+#ifdef CONFIG_BENCHMARK_TIMING
+    timing_init();
+    timing_start();
+#endif
+
+    for (uint32_t i = 0; i < SPO2_WINDOW_SIZE; i++)
+    {
+        bench.ir[i] = BENCH_IR_DC + (bench_pulse(i) * (BENCH_IR_DC / 50)) / 1000;
+        bench.red[i] = BENCH_RED_DC + (bench_pulse(i) * (BENCH_RED_DC * 146 / 10000)) / 1000;
+    }
+
+    /* The FIFO holds the same samples, red first, as the sensor sends them */
+    for (uint32_t i = 0; i < BENCH_BATCH; i++)
+    {
+        uint8_t *sample = &bench.fifo_buf[i * MAX30102_MAX_BYTES_PER_SAMPLE];
+
+        sys_put_be24(bench.red[i], &sample[0]);
+        sys_put_be24(bench.ir[i], &sample[MAX30102_BYTES_PER_CHANNEL]);
+    }
+
+    for (uint32_t i = 0; i < sizeof(bench.crc_buf); i++)
+    {
+        bench.crc_buf[i] = (uint8_t)(i * 37);
+    }
+
+    TC_PRINT("{\"bench\":\"config\",\"cycles_per_sec\":%u,\"iterations\":%u,\"window\":%u,\"fixed_point\":%u}\n",
+        bench_cycles_per_sec(), CONFIG_BENCHMARK_ITERATIONS, (uint32_t)SPO2_WINDOW_SIZE,
+        (uint32_t)IS_ENABLED(CONFIG_APP_SPO2_FIXED_POINT));
+
+    return NULL;
+}
+
+ZTEST_SUITE(benchmarks, NULL, bench_setup, NULL, NULL, NULL);
+
+ZTEST(benchmarks, test_max30102_fifo_unpack)
+{
+    bench_case_run(&(const struct bench_case){"max30102_fifo_unpack", "sample", BENCH_BATCH, NULL,
+        bench_fifo_unpack});
+
+    zassert_mem_equal(bench.fifo_red, bench.red, sizeof(bench.fifo_red));
+    zassert_mem_equal(bench.fifo_ir, bench.ir, sizeof(bench.fifo_ir));
+}
+
+ZTEST(benchmarks, test_spo2_window_add)
+{
+    bench_case_run(&(const struct bench_case){"spo2_window_add", "sample", SPO2_WINDOW_SIZE,
+        bench_window_setup, bench_window_add});
+}
+
+ZTEST(benchmarks, test_spo2_window_calculate)
+{
+    bench_case_run(&(const struct bench_case){"spo2_window_calculate", "window", 1, bench_window_fill,
+        bench_spo2});
+
+    zassert_between_inclusive(bench.spo2, 90, 100, "Implausible SpO2 %u %%", bench.spo2);
+}
+
+ZTEST(benchmarks, test_spo2_window_calculate_fixed)
+{
+    bench_case_run(&(const struct bench_case){"spo2_window_calculate_fixed", "window", 1, bench_window_fill,
+        bench_spo2_fixed});
+}
+
+ZTEST(benchmarks, test_spo2_window_calculate_float)
+{
+    bench_case_run(&(const struct bench_case){"spo2_window_calculate_float", "window", 1, bench_window_fill,
+        bench_spo2_float});
+}
+
+ZTEST(benchmarks, test_spo2_filter_process)
+{
+    bench_case_run(&(const struct bench_case){"spo2_filter_process", "sample", BENCH_BATCH,
+        bench_filter_setup, bench_filter});
+}
+
+ZTEST(benchmarks, test_hr_sample_add)
+{
+    bench_case_run(&(const struct bench_case){"hr_sample_add", "sample", BENCH_BATCH, bench_hr_setup,
+        bench_hr});
+}
+
+ZTEST(benchmarks, test_co2_calculate)
+{
+    bench_case_run(&(const struct bench_case){"co2_calculate", "sample", BENCH_BATCH, NULL, bench_co2});
+}
+
+/* The CRC selected in the STC31 driver must match the bitwise reference for every word */
+ZTEST(benchmarks, test_stc31_crc_check)
+{
+    /* Example from the Sensirion datasheet */
+    uint8_t word[2] = {0xBE, 0xEF};
+
+    zassert_equal(stc31_compute_crc(word, sizeof(word)), 0x92);
+
+    for (uint32_t val = 0; val <= UINT16_MAX; val++)
+    {
+        sys_put_be16(val, word);
+        zassert_equal(stc31_compute_crc(word, sizeof(word)), bench_crc_bitwise_word(word),
+            "CRC mismatch for 0x%04x", val);
+    }
+}
+
+ZTEST(benchmarks, test_stc31_compute_crc)
+{
+    bench_case_run(&(const struct bench_case){"stc31_compute_crc", "word", BENCH_CRC_WORDS, NULL, bench_crc});
+}
+
+ZTEST(benchmarks, test_stc31_crc_bitwise)
+{
+    bench_case_run(&(const struct bench_case){"stc31_crc_bitwise", "word", BENCH_CRC_WORDS, NULL,
+        bench_crc_bitwise});
+}
@@ -0,0 +1,261 @@
+#include <stdlib.h>
+
+#include <zephyr/ztest.h>
+#include <zephyr/sys/util.h>
+
+#include "capno.h"
+
+/* CO2 levels in 1/100 vol% */
+#define ROOM_AIR            4
+#define ETCO2_NORMAL        500
+
+/* Phase II of the capnogram and the drop at the start of the inspiration */
+#define RISE_MS             300
+#define FALL_MS             150
+/* The alveolar plateau climbs by this much up to the end-tidal value */
+#define PLATEAU_SLOPE       30
+
+struct capnogram
+{
+    uint8_t rr;
+    uint16_t etco2;
+    /* Peak noise in 1/100 vol% */
+    uint16_t noise;
+    uint16_t period_ms;
+};
+
+struct capno_result
+{
+    uint32_t breaths;
+    uint8_t rr;
+    uint16_t etco2;
+};
+
+static struct capno_detector capno;
+
+static uint32_t prng_state;
+
+static int32_t prng_noise(uint16_t peak)
+{
+    prng_state ^= prng_state << 13;
+    prng_state ^= prng_state >> 17;
+    prng_state ^= prng_state << 5;
+
+    return (peak == 0) ? 0 : (int32_t)(prng_state % (2U * peak + 1)) - peak;
+}
+
+/*
+ * Expiration over the last 40 % of every breath: phase II rise, then a
+ * slowly climbing plateau ending at the end-tidal value, then a steep
+ * drop back to the inspired level.
+ */
+static uint16_t capnogram_sample(const struct capnogram *c, uint32_t time_ms)
+{
+    uint32_t breath_ms = (60 * 1000) / c->rr;
+    uint32_t t = time_ms % breath_ms;
+    uint32_t expiration_start = (breath_ms * 3) / 5;
+    int32_t val;
+
+    if (t < FALL_MS)
+    {
+        val = c->etco2 - (((c->etco2 - ROOM_AIR) * (int32_t)t) / FALL_MS);
+    }
+    else if (t < expiration_start)
+    {
+        val = ROOM_AIR;
+    }
+    else if (t < (expiration_start + RISE_MS))
+    {
+        val = ROOM_AIR + (((c->etco2 - PLATEAU_SLOPE - ROOM_AIR) * (int32_t)(t - expiration_start)) / RISE_MS);
+    }
+    else
+    {
+        val = c->etco2 - PLATEAU_SLOPE +
+              ((PLATEAU_SLOPE * (int32_t)(t - expiration_start - RISE_MS)) /
+               (int32_t)(breath_ms - expiration_start - RISE_MS));
+    }
+
+    val += prng_noise(c->noise);
+
+    return (uint16_t)MAX(val, 0);
+}
+
+static uint16_t room_air_sample(const struct capnogram *c)
+{
+    int32_t val = ROOM_AIR + prng_noise(c->noise);
+
+    return (uint16_t)MAX(val, 0);
+}
+
+/* Feed the capnogram from start_ms on for duration_ms */
+static void capnogram_run(const struct capnogram *c, uint32_t start_ms, uint32_t duration_ms,
+    struct capno_result *res)
+{
+    res->breaths = 0;
+
+    for (uint32_t time_ms = start_ms; time_ms < (start_ms + duration_ms); time_ms += c->period_ms)
+    {
+        uint16_t co2 = (c->rr == 0) ? room_air_sample(c) : capnogram_sample(c, time_ms);
+
+        if (capno_sample_add(&capno, co2, time_ms))
+        {
+            res->breaths++;
+        }
+    }
+
+    res->rr = capno_rr_get(&capno);
+    res->etco2 = capno_etco2_get(&capno);
+}
+
+static void capnogram_check(const struct capnogram *c)
+{
+    struct capno_result res;
+    /* The detector needs a few samples and a first breath to find the swing */
+    uint32_t expected = c->rr - 2;
+
+    capno_reset(&capno);
+    capnogram_run(c, c->period_ms, 60 * MSEC_PER_SEC, &res);
+
+    zassert_between_inclusive(res.breaths, expected, c->rr, "%u breaths at %u/min, %u ms, noise %u",
+        res.breaths, c->rr, c->period_ms, c->noise);
+    zassert_within(res.rr, c->rr, 1, "RR %u at %u/min, %u ms, noise %u", res.rr, c->rr, c->period_ms,
+        c->noise);
+    /* The last plateau sample can come up to a period before the end-tidal point */
+    zassert_within(res.etco2, c->etco2, c->noise + (PLATEAU_SLOPE / 2),
+        "EtCO2 %u for %u at %u/min, %u ms, noise %u", res.etco2, c->etco2, c->rr, c->period_ms, c->noise);
+}
+
+static void capno_before(void *fixture)
+{
+    ARG_UNUSED(fixture);
+
+    prng_state = 0x2545F491;
+    capno_reset(&capno);
+}
+
+ZTEST_SUITE(capno, NULL, NULL, capno_before, NULL, NULL);
+
+/* From slow breathing to tachypnea, at the fastest and at slower sampling */
+ZTEST(capno, test_rates)
+{
+    static const uint8_t rates[] = {6, 10, 15, 20, 30, 40};
+    static const uint16_t periods[] = {CONFIG_APP_CO2_CAPNOGRAPHY_PERIOD_MS, 100, 200};
+
+    ARRAY_FOR_EACH(periods, p)
+    {
+        ARRAY_FOR_EACH(rates, r)
+        {
+            struct capnogram c =
+            {
+                .rr = rates[r],
+                .etco2 = ETCO2_NORMAL,
+                .noise = 3,
+                .period_ms = periods[p],
+            };
+
+            capnogram_check(&c);
+        }
+    }
+}
+
+ZTEST(capno, test_etco2_levels)
+{
+    static const uint16_t levels[] = {100, 250, 500, 800, 1200};
+
+    ARRAY_FOR_EACH(levels, l)
+    {
+        struct capnogram c =
+        {
+            .rr = 12,
+            .etco2 = levels[l],
+            .noise = 3,
+            .period_ms = CONFIG_APP_CO2_CAPNOGRAPHY_PERIOD_MS,
+        };
+
+        capnogram_check(&c);
+    }
+}
+
+/* Noise on the plateau or the baseline must not split a breath in two */
+ZTEST(capno, test_noise)
+{
+    static const uint16_t noises[] = {10, 25, 50};
+
+    ARRAY_FOR_EACH(noises, n)
+    {
+        struct capnogram c =
+        {
+            .rr = 15,
+            .etco2 = ETCO2_NORMAL,
+            .noise = noises[n],
+            .period_ms = CONFIG_APP_CO2_CAPNOGRAPHY_PERIOD_MS,
+        };
+
+        capnogram_check(&c);
+    }
+}
+
+/* The sensor in room air sees no breath at all */
+ZTEST(capno, test_room_air)
+{
+    struct capnogram c =
+    {
+        .rr = 0,
+        .noise = 20,
+        .period_ms = CONFIG_APP_CO2_CAPNOGRAPHY_PERIOD_MS,
+    };
+    struct capno_result res;
+
+    capnogram_run(&c, c.period_ms, 60 * MSEC_PER_SEC, &res);
+
+    zassert_equal(res.breaths, 0);
+    zassert_equal(res.rr, 0);
+    zassert_equal(res.etco2, 0);
+}
+
+/* The rate starts over after a pause longer than 15 s */
+ZTEST(capno, test_apnea)
+{
+    struct capnogram breathing =
+    {
+        .rr = 15,
+        .etco2 = ETCO2_NORMAL,
+        .noise = 3,
+        .period_ms = CONFIG_APP_CO2_CAPNOGRAPHY_PERIOD_MS,
+    };
+    struct capnogram apnea = breathing;
+    struct capno_result res;
+
+    apnea.rr = 0;
+
+    capnogram_run(&breathing, breathing.period_ms, 30 * MSEC_PER_SEC, &res);
+    zassert_within(res.rr, 15, 1);
+
+    capnogram_run(&apnea, 30 * MSEC_PER_SEC, 20 * MSEC_PER_SEC, &res);
+    zassert_equal(res.breaths, 0);
+
+    /* The first breath after the pause only gives an interval once the second one starts */
+    capnogram_run(&breathing, 50 * MSEC_PER_SEC, 5 * MSEC_PER_SEC, &res);
+    zassert_equal(res.rr, 0, "RR %u right after the apnea", res.rr);
+
+    capnogram_run(&breathing, 55 * MSEC_PER_SEC, 30 * MSEC_PER_SEC, &res);
+    zassert_within(res.rr, 15, 1);
+}
+
+ZTEST(capno, test_reset)
+{
+    struct capnogram c =
+    {
+        .rr = 20,
+        .etco2 = ETCO2_NORMAL,
+        .period_ms = CONFIG_APP_CO2_CAPNOGRAPHY_PERIOD_MS,
+    };
+    struct capno_result res;
+
+    capnogram_run(&c, c.period_ms, 30 * MSEC_PER_SEC, &res);
+    zassert_not_equal(res.rr, 0);
+
+    capno_reset(&capno);
+    zassert_equal(capno_rr_get(&capno), 0);
+    zassert_equal(capno_etco2_get(&capno), 0);
+}
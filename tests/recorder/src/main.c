@@ -0,0 +1,492 @@
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/zbus/zbus.h>
+
+#include "channels.h"
+#include "ppg_codec.h"
+#include "recorder.h"
+#include "sample_block.h"
+#include "sched.h"
+
+#define SAMPLE_MAX             BIT_MASK(PPG_CODEC_SAMPLE_BITS)
+#define SAMPLE_RATE_HZ         100
+/* Samples per block with the FIFO watermark at 4 free slots */
+#define BLOCK_COUNT            28
+
+#define PI                     3.14159265358979323846
+
+/* Messages published before letting the DSP work queue drain them */
+#define RECORDER_BURST         4
+#define RECORDER_MAX_SESSIONS  8
+
+/* Synthetic PPG, at the DC level the AGC settles to */
+struct ppg_params
+{
+    uint32_t red_dc;
+    uint32_t ir_dc;
+    /* AC amplitude relative to the DC level */
+    double perfusion;
+    uint16_t bpm;
+    /* Peak noise in ADC counts */
+    uint16_t noise;
+};
+
+struct recorder_sessions
+{
+    struct recorder_summary summary[RECORDER_MAX_SESSIONS];
+    uint8_t count;
+};
+
+static uint32_t prng_state;
+
+static uint32_t red[SAMPLE_BLOCK_SIZE];
+static uint32_t ir[SAMPLE_BLOCK_SIZE];
+static uint32_t red_out[SAMPLE_BLOCK_SIZE];
+static uint32_t ir_out[SAMPLE_BLOCK_SIZE];
+static uint8_t buf[PPG_CODEC_MAX_SIZE(SAMPLE_BLOCK_SIZE)];
+
+static struct recorder_sessions sessions;
+
+static uint32_t prng_next(void)
+{
+    prng_state ^= prng_state << 13;
+    prng_state ^= prng_state >> 17;
+    prng_state ^= prng_state << 5;
+
+    return prng_state;
+}
+
+static int32_t prng_noise(uint16_t peak)
+{
+    return (peak == 0) ? 0 : (int32_t)(prng_next() % (2U * peak + 1)) - peak;
+}
+
+static uint32_t ppg_sample(uint32_t dc, double perfusion, double pulse, uint16_t noise)
+{
+    double val = dc * (1.0 + (perfusion * pulse)) + prng_noise(noise);
+
+    return (uint32_t)CLAMP(val, 0.0, (double)SAMPLE_MAX);
+}
+
+/* Fill a block from sample n on, the pulse carries a dicrotic harmonic */
+static void ppg_block_fill(const struct ppg_params *p, uint32_t n, uint8_t count)
+{
+    for (uint8_t i = 0; i < count; i++)
+    {
+        double phase = (2.0 * PI * p->bpm * (n + i)) / (60.0 * SAMPLE_RATE_HZ);
+        double pulse = sin(phase) + (0.3 * sin((2.0 * phase) + 1.0));
+
+        red[i] = ppg_sample(p->red_dc, p->perfusion, pulse, p->noise);
+        ir[i] = ppg_sample(p->ir_dc, p->perfusion / 2.0, pulse, p->noise);
+    }
+}
+
+static void ppg_round_trip_check(uint8_t count)
+{
+    int len = ppg_codec_encode(red, ir, count, buf, sizeof(buf));
+
+    zassert_true(len > 0, "Encoding %u samples failed (%d)", count, len);
+    zassert_true(len <= PPG_CODEC_MAX_SIZE(count), "%d bytes for %u samples", len, count);
+
+    memset(red_out, 0, sizeof(red_out));
+    memset(ir_out, 0, sizeof(ir_out));
+
+    zassert_equal(ppg_codec_decode(buf, len, red_out, ir_out, SAMPLE_BLOCK_SIZE), count);
+    zassert_mem_equal(red_out, red, count * sizeof(red[0]));
+    zassert_mem_equal(ir_out, ir, count * sizeof(ir[0]));
+}
+
+static void ppg_codec_before(void *fixture)
+{
+    ARG_UNUSED(fixture);
+
+    prng_state = 0x2545F491;
+}
+
+ZTEST_SUITE(ppg_codec, NULL, NULL, ppg_codec_before, NULL, NULL);
+
+/* Every block size, from a flat signal to a noisy full scale pulse */
+ZTEST(ppg_codec, test_round_trip)
+{
+    static const struct ppg_params params[] =
+    {
+        {100000, 130000, 0.02, 72, 20},
+        {4000, 6000, 0.002, 40, 0},
+        {SAMPLE_MAX / 2, SAMPLE_MAX / 2, 0.9, 180, 2000},
+    };
+
+    ARRAY_FOR_EACH(params, p)
+    {
+        for (uint8_t count = 1; count <= SAMPLE_BLOCK_SIZE; count++)
+        {
+            ppg_block_fill(&params[p], count * 7, count);
+            ppg_round_trip_check(count);
+        }
+    }
+}
+
+/* Random samples over the whole 18-bit scale */
+ZTEST(ppg_codec, test_random)
+{
+    for (int n = 0; n < 100; n++)
+    {
+        for (uint8_t i = 0; i < SAMPLE_BLOCK_SIZE; i++)
+        {
+            red[i] = prng_next() & SAMPLE_MAX;
+            ir[i] = prng_next() & SAMPLE_MAX;
+        }
+
+        ppg_round_trip_check(SAMPLE_BLOCK_SIZE);
+    }
+}
+
+/* A flat channel has no delta bits at all */
+ZTEST(ppg_codec, test_width_0)
+{
+    for (uint8_t i = 0; i < SAMPLE_BLOCK_SIZE; i++)
+    {
+        red[i] = 123456;
+        ir[i] = 1000 + i;
+    }
+
+    ppg_round_trip_check(SAMPLE_BLOCK_SIZE);
+    zassert_equal(buf[1], 0);
+    zassert_equal(buf[2], 2);
+
+    for (uint8_t i = 0; i < SAMPLE_BLOCK_SIZE; i++)
+    {
+        ir[i] = SAMPLE_MAX;
+    }
+
+    zassert_equal(ppg_codec_encode(red, ir, SAMPLE_BLOCK_SIZE, buf, sizeof(buf)), 9);
+    ppg_round_trip_check(SAMPLE_BLOCK_SIZE);
+}
+
+/* Full scale steps both ways take the 19 bits of the worst case */
+ZTEST(ppg_codec, test_19_bit_deltas)
+{
+    for (uint8_t i = 0; i < SAMPLE_BLOCK_SIZE; i++)
+    {
+        red[i] = (i % 2) ? SAMPLE_MAX : 0;
+        ir[i] = (i % 2) ? 0 : SAMPLE_MAX;
+    }
+
+    zassert_equal(ppg_codec_encode(red, ir, SAMPLE_BLOCK_SIZE, buf, sizeof(buf)),
+        PPG_CODEC_MAX_SIZE(SAMPLE_BLOCK_SIZE));
+    zassert_equal(buf[1], PPG_CODEC_SAMPLE_BITS + 1);
+    zassert_equal(buf[2], PPG_CODEC_SAMPLE_BITS + 1);
+    ppg_round_trip_check(SAMPLE_BLOCK_SIZE);
+}
+
+/* Bits above the 18 of the ADC are not part of the sample */
+ZTEST(ppg_codec, test_sample_mask)
+{
+    for (uint8_t i = 0; i < SAMPLE_BLOCK_SIZE; i++)
+    {
+        red[i] = 0xFFFC0000 | (i * 100);
+        ir[i] = 0x00040000 | (i * 50);
+    }
+
+    zassert_true(ppg_codec_encode(red, ir, SAMPLE_BLOCK_SIZE, buf, sizeof(buf)) > 0);
+    zassert_equal(ppg_codec_decode(buf, sizeof(buf), red_out, ir_out, SAMPLE_BLOCK_SIZE), SAMPLE_BLOCK_SIZE);
+
+    for (uint8_t i = 0; i < SAMPLE_BLOCK_SIZE; i++)
+    {
+        zassert_equal(red_out[i], red[i] & SAMPLE_MAX);
+        zassert_equal(ir_out[i], ir[i] & SAMPLE_MAX);
+    }
+}
+
+ZTEST(ppg_codec, test_count_1)
+{
+    red[0] = SAMPLE_MAX;
+    ir[0] = 1;
+
+    zassert_equal(ppg_codec_encode(red, ir, 1, buf, sizeof(buf)), 9);
+    ppg_round_trip_check(1);
+}
+
+ZTEST(ppg_codec, test_count_0)
+{
+    zassert_equal(ppg_codec_encode(red, ir, 0, buf, sizeof(buf)), 1);
+    zassert_equal(buf[0], 0);
+    zassert_equal(ppg_codec_decode(buf, 1, red_out, ir_out, SAMPLE_BLOCK_SIZE), 0);
+    zassert_equal(ppg_codec_encode(red, ir, 0, buf, 0), -ENOMEM);
+}
+
+ZTEST(ppg_codec, test_buffer_too_small)
+{
+    struct ppg_params p = {100000, 130000, 0.02, 72, 20};
+    int len;
+
+    ppg_block_fill(&p, 0, SAMPLE_BLOCK_SIZE);
+    len = ppg_codec_encode(red, ir, SAMPLE_BLOCK_SIZE, buf, sizeof(buf));
+    zassert_true(len > 0);
+
+    zassert_equal(ppg_codec_encode(red, ir, SAMPLE_BLOCK_SIZE, buf, len - 1), -ENOMEM);
+    zassert_equal(ppg_codec_encode(red, ir, SAMPLE_BLOCK_SIZE, buf, len), len);
+}
+
+/* Every byte of a block is needed, a cut at any point is detected */
+ZTEST(ppg_codec, test_truncated)
+{
+    struct ppg_params p = {100000, 130000, 0.02, 72, 20};
+    int len;
+
+    ppg_block_fill(&p, 0, SAMPLE_BLOCK_SIZE);
+    len = ppg_codec_encode(red, ir, SAMPLE_BLOCK_SIZE, buf, sizeof(buf));
+    zassert_true(len > 0);
+
+    for (int cut = 0; cut < len; cut++)
+    {
+        zassert_equal(ppg_codec_decode(buf, cut, red_out, ir_out, SAMPLE_BLOCK_SIZE), -EINVAL,
+            "%d of %d bytes decoded", cut, len);
+    }
+}
+
+ZTEST(ppg_codec, test_malformed)
+{
+    struct ppg_params p = {100000, 130000, 0.02, 72, 20};
+    int len;
+
+    ppg_block_fill(&p, 0, SAMPLE_BLOCK_SIZE);
+    len = ppg_codec_encode(red, ir, SAMPLE_BLOCK_SIZE, buf, sizeof(buf));
+    zassert_true(len > 0);
+
+    /* More samples than the caller has room for */
+    zassert_equal(ppg_codec_decode(buf, len, red_out, ir_out, SAMPLE_BLOCK_SIZE - 1), -EINVAL);
+
+    /* A delta wider than an 18-bit step */
+    buf[1] = PPG_CODEC_SAMPLE_BITS + 2;
+    zassert_equal(ppg_codec_decode(buf, len, red_out, ir_out, SAMPLE_BLOCK_SIZE), -EINVAL);
+}
+
+/*
+ * Size of a minute of PPG against the same samples packed on 18 bits.
+ * The per block header and the width of the largest delta of each block
+ * are part of the figure.
+ */
+ZTEST(ppg_codec, test_compression_ratio)
+{
+    static const struct ppg_params params[] =
+    {
+        {100000, 130000, 0.02, 72, 20},
+        {100000, 130000, 0.05, 120, 50},
+    };
+
+    ARRAY_FOR_EACH(params, p)
+    {
+        uint32_t samples = 0;
+        uint32_t bytes = 0;
+
+        for (uint32_t n = 0; n < (60 * SAMPLE_RATE_HZ); n += BLOCK_COUNT)
+        {
+            int len;
+
+            ppg_block_fill(&params[p], n, BLOCK_COUNT);
+            len = ppg_codec_encode(red, ir, BLOCK_COUNT, buf, sizeof(buf));
+            zassert_true(len > 0);
+
+            samples += 2 * BLOCK_COUNT;
+            bytes += len;
+        }
+
+        uint32_t packed = (samples * PPG_CODEC_SAMPLE_BITS) / 8;
+        uint32_t ratio_x100 = (packed * 100) / bytes;
+
+        TC_PRINT("{\"perfusion\":%u,\"noise\":%u,\"samples\":%u,\"bytes\":%u,\"bits_per_sample\":%u.%02u,"
+                 "\"ratio_vs_18bit_x100\":%u,\"ratio_vs_32bit_x100\":%u}\n",
+            (uint32_t)(params[p].perfusion * 1000), params[p].noise, samples, bytes, (bytes * 8) / samples,
+            ((bytes * 800) / samples) % 100, ratio_x100, (samples * 4 * 100) / bytes);
+
+        zassert_true(ratio_x100 >= 140, "Only %u.%02u times smaller than 18-bit packing", ratio_x100 / 100,
+            ratio_x100 % 100);
+    }
+}
+
+static void recorder_session_cb(const struct recorder_summary *summary, void *user_data)
+{
+    struct recorder_sessions *s = user_data;
+
+    zassert_true(s->count < RECORDER_MAX_SESSIONS);
+    s->summary[s->count++] = *summary;
+}
+
+static void recorder_sessions_read(void)
+{
+    memset(&sessions, 0, sizeof(sessions));
+
+    recorder_flush();
+    zassert_equal(recorder_sessions_walk(recorder_session_cb, &sessions), 0, "Unreadable entries");
+
+    for (uint8_t i = 0; i < sessions.count; i++)
+    {
+        zassert_equal(sessions.summary[i].errors, 0, "Session %u has errors", sessions.summary[i].session);
+    }
+}
+
+/* The listener queues without waiting, so the DSP queue must run between bursts */
+static void recorder_drain_wait(uint32_t published)
+{
+    if ((published % RECORDER_BURST) == 0)
+    {
+        k_msleep(1);
+    }
+}
+
+static void recorder_readings_publish(uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        struct spo2_msg spo2 = {.spo2 = 97, .hr = 60 + (i % 40)};
+        struct co2_raw_msg co2 = {.co2 = 400 + i, .time_ms = i * 100};
+        struct etco2_msg etco2 = {.etco2 = 500, .rr = 15};
+
+        zassert_ok(zbus_chan_pub(&spo2_chan, &spo2, K_NO_WAIT));
+        zassert_ok(zbus_chan_pub(&co2_raw_chan, &co2, K_NO_WAIT));
+        zassert_ok(zbus_chan_pub(&etco2_chan, &etco2, K_NO_WAIT));
+        k_msleep(1);
+    }
+}
+
+static void recorder_blocks_publish(uint32_t count)
+{
+    struct ppg_params p = {100000, 130000, 0.02, 72, 20};
+
+    for (uint32_t n = 0; n < count; n++)
+    {
+        struct sample_block *block = sample_block_alloc();
+
+        zassert_not_null(block, "Sample pool exhausted at block %u", n);
+
+        ppg_block_fill(&p, n * BLOCK_COUNT, BLOCK_COUNT);
+        memcpy(block->red, red, sizeof(block->red));
+        memcpy(block->ir, ir, sizeof(block->ir));
+        block->count = BLOCK_COUNT;
+
+        struct ppg_block_msg msg = {.block = block};
+
+        zassert_ok(zbus_chan_pub(&ppg_block_chan, &msg, K_NO_WAIT));
+        sample_block_unref(block);
+        recorder_drain_wait(n + 1);
+    }
+}
+
+static void *recorder_setup(void)
+{
+    sched_init();
+
+    return NULL;
+}
+
+/* Every test starts from an empty partition and session 0 */
+static void recorder_before(void *fixture)
+{
+    const struct flash_area *fa;
+
+    ARG_UNUSED(fixture);
+
+    prng_state = 0x2545F491;
+
+    zassert_ok(flash_area_open(FIXED_PARTITION_ID(storage_partition), &fa));
+    zassert_ok(flash_area_erase(fa, 0, fa->fa_size));
+    flash_area_close(fa);
+
+    zassert_ok(recorder_init());
+}
+
+ZTEST_SUITE(recorder, NULL, recorder_setup, recorder_before, NULL, NULL);
+
+ZTEST(recorder, test_empty)
+{
+    recorder_sessions_read();
+    zassert_equal(sessions.count, 0);
+}
+
+/* Every reading and block comes back from the flash */
+ZTEST(recorder, test_read_back)
+{
+    recorder_readings_publish(10);
+    recorder_blocks_publish(20);
+    recorder_sessions_read();
+
+    zassert_equal(sessions.count, 1);
+    zassert_equal(sessions.summary[0].session, 0);
+    zassert_equal(sessions.summary[0].records[RECORDER_SPO2], 10);
+    zassert_equal(sessions.summary[0].records[RECORDER_CO2], 10);
+    zassert_equal(sessions.summary[0].records[RECORDER_ETCO2], 10);
+    zassert_equal(sessions.summary[0].records[RECORDER_PPG], 20);
+    zassert_equal(sessions.summary[0].ppg_samples, 20 * BLOCK_COUNT);
+    zassert_true(sessions.summary[0].entries > 1, "%u batches", sessions.summary[0].entries);
+}
+
+/* A flush only writes what is pending, an empty batch is not written */
+ZTEST(recorder, test_flush)
+{
+    recorder_readings_publish(1);
+    recorder_sessions_read();
+    zassert_equal(sessions.summary[0].entries, 1);
+
+    recorder_sessions_read();
+    zassert_equal(sessions.summary[0].entries, 1);
+
+    recorder_readings_publish(1);
+    recorder_sessions_read();
+    zassert_equal(sessions.summary[0].entries, 2);
+    zassert_equal(sessions.summary[0].records[RECORDER_SPO2], 2);
+}
+
+/* Every boot starts a new session after the stored ones */
+ZTEST(recorder, test_sessions)
+{
+    recorder_readings_publish(3);
+    recorder_flush();
+
+    zassert_ok(recorder_init());
+    recorder_readings_publish(5);
+    recorder_sessions_read();
+
+    zassert_equal(sessions.count, 2);
+    zassert_equal(sessions.summary[0].session, 0);
+    zassert_equal(sessions.summary[0].records[RECORDER_SPO2], 3);
+    zassert_equal(sessions.summary[1].session, 1);
+    zassert_equal(sessions.summary[1].records[RECORDER_SPO2], 5);
+}
+
+/* A full partition erases its oldest sector and keeps the newest data readable */
+ZTEST(recorder, test_rotation)
+{
+    uint32_t blocks = 0;
+
+    recorder_readings_publish(3);
+    recorder_flush();
+
+    zassert_ok(recorder_init());
+
+    /* Twice the partition size of encoded blocks */
+    while ((blocks * PPG_CODEC_MAX_SIZE(BLOCK_COUNT) / 2) < (2 * FIXED_PARTITION_SIZE(storage_partition)))
+    {
+        recorder_blocks_publish(RECORDER_BURST);
+        blocks += RECORDER_BURST;
+    }
+
+    recorder_sessions_read();
+
+    /* The first session went with the oldest sector */
+    zassert_equal(sessions.count, 1);
+    zassert_equal(sessions.summary[0].session, 1);
+    zassert_true(sessions.summary[0].records[RECORDER_PPG] < blocks, "%u of %u blocks still stored",
+        sessions.summary[0].records[RECORDER_PPG], blocks);
+    zassert_true(sessions.summary[0].bytes <= FIXED_PARTITION_SIZE(storage_partition));
+
+    /* The partition keeps accepting batches */
+    recorder_readings_publish(2);
+    recorder_sessions_read();
+    zassert_equal(sessions.summary[sessions.count - 1].records[RECORDER_SPO2], 2);
+}
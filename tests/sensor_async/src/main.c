@@ -0,0 +1,113 @@
+#include <zephyr/ztest.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/drivers/sensor.h>
+#include <zephyr/pm/device_runtime.h>
+#include <zephyr/rtio/rtio.h>
+
+#include "max30102.h"
+#include "max30102_emul.h"
+#include "stc31.h"
+#include "stc31_emul.h"
+
+#define MAX30102_NODE    DT_NODELABEL(max30102)
+#define STC31_NODE       DT_NODELABEL(stc31)
+
+/* Constant 18-bit samples, so that every decoded reading is known */
+#define RED_SAMPLE    0x12345
+#define IR_SAMPLE     0x2abcd
+
+/* Gas ticks of 2 vol% CO2, in the 100 % range set by the driver */
+#define CO2_2_PERCENT_TICKS    (16384 + ((2 * 32768) / 100))
+
+static const struct device *const max30102 = DEVICE_DT_GET(MAX30102_NODE);
+static const struct device *const stc31 = DEVICE_DT_GET(STC31_NODE);
+
+SENSOR_DT_READ_IODEV(max30102_iodev, MAX30102_NODE, {SENSOR_CHAN_RED, 0}, {SENSOR_CHAN_IR, 0});
+SENSOR_DT_READ_IODEV(stc31_iodev, STC31_NODE, {SENSOR_CHAN_CO2, 0});
+
+RTIO_DEFINE(sensor_ctx, 1, 1);
+
+static uint8_t read_buf[sizeof(struct max30102_encoded_data) +
+                        (MAX30102_FIFO_DEPTH * MAX30102_MAX_BYTES_PER_SAMPLE)] __aligned(8);
+
+/* Decode every frame of the channel one at a time and count them */
+static void decode_all(const struct sensor_decoder_api *decoder, enum sensor_channel chan, int32_t expected,
+                       uint16_t *count)
+{
+    struct sensor_chan_spec spec = {chan, 0};
+    struct sensor_q31_data out;
+    uint32_t fit = 0;
+
+    *count = 0;
+    while (decoder->decode(read_buf, spec, &fit, 1, &out) == 1)
+    {
+        zassert_equal(out.header.reading_count, 1);
+        zassert_equal(out.readings[0].value >> (31 - out.shift), expected, "Frame %u of channel %d", *count, chan);
+        (*count)++;
+    }
+}
+
+static void *sensor_async_setup(void)
+{
+    zassert_true(device_is_ready(max30102));
+    zassert_true(device_is_ready(stc31));
+
+    return NULL;
+}
+
+ZTEST(sensor_async, test_max30102_read_decode)
+{
+    static const uint32_t red = RED_SAMPLE;
+    static const uint32_t ir = IR_SAMPLE;
+    const struct emul *emul = EMUL_DT_GET(MAX30102_NODE);
+    const struct sensor_decoder_api *decoder;
+    uint16_t frames;
+    uint16_t decoded;
+    int err;
+
+    max30102_emul_playback_set(emul, &red, &ir, 1);
+
+    /* The resume flushes the FIFO, about 10 samples are taken at 100 Hz */
+    zassert_ok(pm_device_runtime_get(max30102));
+    k_msleep(100);
+    err = sensor_read(&max30102_iodev, &sensor_ctx, read_buf, sizeof(read_buf));
+    zassert_ok(pm_device_runtime_put(max30102));
+    zassert_ok(err);
+
+    zassert_ok(sensor_get_decoder(max30102, &decoder));
+    zassert_ok(decoder->get_frame_count(read_buf, (struct sensor_chan_spec){SENSOR_CHAN_RED, 0}, &frames));
+    zassert_between_inclusive(frames, 5, MAX30102_FIFO_DEPTH);
+
+    decode_all(decoder, SENSOR_CHAN_RED, RED_SAMPLE, &decoded);
+    zassert_equal(decoded, frames);
+    decode_all(decoder, SENSOR_CHAN_IR, IR_SAMPLE, &decoded);
+    zassert_equal(decoded, frames);
+
+    max30102_emul_playback_set(emul, NULL, 0, 0);
+}
+
+ZTEST(sensor_async, test_stc31_read_decode)
+{
+    static const uint16_t ticks = CO2_2_PERCENT_TICKS;
+    const struct emul *emul = EMUL_DT_GET(STC31_NODE);
+    const struct sensor_decoder_api *decoder;
+    struct sensor_q31_data out;
+    uint32_t fit = 0;
+
+    stc31_emul_playback_set(emul, &ticks, 1);
+
+    /* Also through the wake-up, the measurement completes on the work queue */
+    zassert_ok(stc31_sleep(stc31));
+    zassert_ok(sensor_read(&stc31_iodev, &sensor_ctx, read_buf, sizeof(read_buf)));
+
+    zassert_ok(sensor_get_decoder(stc31, &decoder));
+    zassert_equal(decoder->decode(read_buf, (struct sensor_chan_spec){SENSOR_CHAN_CO2, 0}, &fit, 1, &out), 1);
+
+    /* 2 vol% is 20000 ppm, less the rounding of the ticks */
+    zassert_within(out.readings[0].value >> (31 - out.shift), 20000, 20);
+
+    stc31_emul_playback_set(emul, NULL, 0);
+}
+
+ZTEST_SUITE(sensor_async, NULL, sensor_async_setup, NULL, NULL, NULL);
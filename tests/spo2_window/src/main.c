@@ -0,0 +1,278 @@
+#include <stdlib.h>
+#include <math.h>
+
+#include <zephyr/ztest.h>
+#include <zephyr/sys/util.h>
+
+#include "spo2_window.h"
+#include "spo2_filter.h"
+
+/* Largest difference allowed between the fixed point path and the reference */
+#define SPO2_TOLERANCE          1
+/* Largest difference allowed between the reference and the curve on a clean signal */
+#define SPO2_CURVE_TOLERANCE    2
+/* Smallest IR pulse amplitude in ADC counts for the rounding to stay below the tolerance */
+#define SPO2_CURVE_MIN_AC       100
+
+#define SAMPLE_RATE_HZ          (1000 / SPO2_SAMPLING_TIME_MS)
+#define SAMPLE_MAX              0x3FFFF
+
+#define PI                      3.14159265358979323846
+
+/* Synthetic PPG, the IR perfusion index is the red one divided by the ratio */
+struct ppg_params
+{
+    uint32_t red_dc;
+    uint32_t ir_dc;
+    /* Red AC amplitude relative to the DC level */
+    double perfusion;
+    double ratio;
+    uint16_t bpm;
+    /* Peak noise in ADC counts */
+    uint16_t noise;
+    /* Baseline drift relative to the DC level, at 0.05 Hz */
+    double drift;
+};
+
+static struct spo2_window dc_window;
+static struct spo2_window ac_window;
+static struct spo2_filter red_filter;
+static struct spo2_filter ir_filter;
+
+static uint32_t prng_state;
+
+static int32_t prng_noise(uint16_t peak)
+{
+    /* xorshift32, enough to decorrelate both channels */
+    prng_state ^= prng_state << 13;
+    prng_state ^= prng_state >> 17;
+    prng_state ^= prng_state << 5;
+
+    return (peak == 0) ? 0 : (int32_t)(prng_state % (2U * peak + 1)) - peak;
+}
+
+/* Pulse with a dicrotic harmonic, same shape on both channels */
+static double ppg_pulse(uint32_t n, uint16_t bpm)
+{
+    double phase = (2.0 * PI * bpm * n) / (60.0 * SAMPLE_RATE_HZ);
+
+    return sin(phase) + (0.3 * sin((2.0 * phase) + 1.0));
+}
+
+static uint32_t ppg_sample(uint32_t dc, double perfusion, double pulse, double drift, int32_t noise)
+{
+    double val = dc * (1.0 + drift + (perfusion * pulse)) + noise;
+
+    return (uint32_t)CLAMP(val, 0.0, (double)SAMPLE_MAX);
+}
+
+static void ppg_sample_get(const struct ppg_params *p, uint32_t n, uint32_t *red, uint32_t *ir)
+{
+    double pulse = ppg_pulse(n, p->bpm);
+    double drift = p->drift * sin((2.0 * PI * 0.05 * n) / SAMPLE_RATE_HZ);
+
+    *red = ppg_sample(p->red_dc, p->perfusion, pulse, drift, prng_noise(p->noise));
+    *ir = ppg_sample(p->ir_dc, p->perfusion / p->ratio, pulse, drift, prng_noise(p->noise));
+}
+
+/* Fill the raw window, the same window holds the AC levels */
+static void ppg_window_fill(const struct ppg_params *p, uint32_t len)
+{
+    uint32_t red;
+    uint32_t ir;
+
+    spo2_window_reset(&dc_window);
+
+    for (uint32_t n = 0; n < len; n++)
+    {
+        ppg_sample_get(p, n, &red, &ir);
+        spo2_window_add(&dc_window, red, ir);
+    }
+}
+
+/* Fill the raw window and the band-passed window as with APP_SPO2_FILTER */
+static void ppg_window_fill_filtered(const struct ppg_params *p, uint32_t len)
+{
+    uint32_t red;
+    uint32_t ir;
+    int32_t red_ac;
+    int32_t ir_ac;
+
+    spo2_window_reset(&dc_window);
+    spo2_window_reset(&ac_window);
+    spo2_filter_init(&red_filter);
+    spo2_filter_init(&ir_filter);
+
+    for (uint32_t n = 0; n < len; n++)
+    {
+        ppg_sample_get(p, n, &red, &ir);
+        spo2_filter_process(&red_filter, &red, &red_ac, 1);
+        spo2_filter_process(&ir_filter, &ir, &ir_ac, 1);
+        spo2_window_add(&dc_window, red, ir);
+        spo2_window_add(&ac_window, red_ac, ir_ac);
+    }
+}
+
+static void spo2_check(const struct spo2_window *ac, const struct ppg_params *p)
+{
+    int fixed = spo2_window_calculate_fixed(&dc_window, ac);
+    int ref = spo2_window_calculate_float(&dc_window, ac);
+
+    zassert_true(abs(fixed - ref) <= SPO2_TOLERANCE,
+        "fixed %d %% vs float %d %% for DC %u/%u, PI %.4f, R %.2f, %u bpm, noise %u", fixed, ref,
+        p->red_dc, p->ir_dc, p->perfusion, p->ratio, p->bpm, p->noise);
+}
+
+static void spo2_curve_check(const struct ppg_params *p)
+{
+    double curve = CLAMP(101.72 - (6.4619 * p->ratio), 0.0, 100.0);
+    int ref = spo2_window_calculate_float(&dc_window, &dc_window);
+
+    zassert_true(fabs(ref - curve) <= SPO2_CURVE_TOLERANCE, "float %d %% vs curve %.1f %% for R %.2f", ref, curve,
+        p->ratio);
+}
+
+static void spo2_window_before(void *fixture)
+{
+    ARG_UNUSED(fixture);
+
+    prng_state = 0x2545F491;
+}
+
+ZTEST_SUITE(spo2_window, NULL, NULL, spo2_window_before, NULL, NULL);
+
+/* Clean and noisy pulses over the whole calibration curve and DC range */
+ZTEST(spo2_window, test_synthetic_raw)
+{
+    static const uint32_t dc_levels[] = {4000, 30000, 120000, 160000};
+    static const double perfusions[] = {0.002, 0.01, 0.05};
+    static const uint16_t rates[] = {40, 75, 180};
+    static const uint16_t noises[] = {0, 50};
+
+    ARRAY_FOR_EACH(dc_levels, d)
+    {
+        ARRAY_FOR_EACH(perfusions, i)
+        {
+            ARRAY_FOR_EACH(rates, b)
+            {
+                ARRAY_FOR_EACH(noises, k)
+                {
+                    for (int r = 4; r <= 34; r += 3)
+                    {
+                        struct ppg_params p =
+                        {
+                            .red_dc = dc_levels[d],
+                            .ir_dc = (dc_levels[d] * 3) / 2,
+                            .perfusion = perfusions[i],
+                            .ratio = r / 10.0,
+                            .bpm = rates[b],
+                            .noise = noises[k],
+                        };
+
+                        ppg_window_fill(&p, SPO2_WINDOW_SIZE);
+                        zassert_true(spo2_window_full(&dc_window));
+                        spo2_check(&dc_window, &p);
+
+                        if ((p.noise == 0) && ((p.ir_dc * p.perfusion / p.ratio) >= SPO2_CURVE_MIN_AC))
+                        {
+                            spo2_curve_check(&p);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+/* Band-passed AC levels over drifting raw DC levels */
+ZTEST(spo2_window, test_synthetic_filtered)
+{
+    static const double drifts[] = {0.0, 0.02, 0.1};
+
+    ARRAY_FOR_EACH(drifts, d)
+    {
+        for (int r = 4; r <= 34; r += 5)
+        {
+            struct ppg_params p =
+            {
+                .red_dc = 60000,
+                .ir_dc = 90000,
+                .perfusion = 0.02,
+                .ratio = r / 10.0,
+                .bpm = 72,
+                .noise = 20,
+                .drift = drifts[d],
+            };
+
+            /* Long enough for the filters to settle before the window */
+            ppg_window_fill_filtered(&p, 2 * SPO2_WINDOW_SIZE);
+            spo2_check(&ac_window, &p);
+        }
+    }
+}
+
+/* Windows still filling up, as for the first continuous readings */
+ZTEST(spo2_window, test_partial_window)
+{
+    struct ppg_params p =
+    {
+        .red_dc = 50000,
+        .ir_dc = 50000,
+        .perfusion = 0.01,
+        .ratio = 1.0,
+        .bpm = 60,
+        .noise = 10,
+    };
+
+    for (uint32_t len = 2; len < SPO2_WINDOW_SIZE; len += 37)
+    {
+        ppg_window_fill(&p, len);
+        zassert_false(spo2_window_full(&dc_window));
+        spo2_check(&dc_window, &p);
+    }
+}
+
+/* Both paths must agree on the extremes of the 18-bit scale */
+ZTEST(spo2_window, test_full_scale)
+{
+    struct ppg_params p =
+    {
+        .red_dc = SAMPLE_MAX / 2,
+        .ir_dc = SAMPLE_MAX / 2,
+        .perfusion = 0.9,
+        .ratio = 1.0,
+        .bpm = 90,
+        .noise = 1000,
+    };
+
+    for (int r = 1; r <= 40; r += 3)
+    {
+        p.ratio = r / 10.0;
+        ppg_window_fill(&p, SPO2_WINDOW_SIZE);
+        spo2_check(&dc_window, &p);
+    }
+}
+
+ZTEST(spo2_window, test_degenerate)
+{
+    spo2_window_reset(&dc_window);
+    zassert_equal(spo2_window_calculate_fixed(&dc_window, &dc_window), 0);
+    zassert_equal(spo2_window_calculate_float(&dc_window, &dc_window), 0);
+
+    /* A flat IR channel has no AC level to divide by */
+    for (int n = 0; n < SPO2_WINDOW_SIZE; n++)
+    {
+        spo2_window_add(&dc_window, 1000 + (n % 7), 1000);
+    }
+    zassert_equal(spo2_window_calculate_fixed(&dc_window, &dc_window), 0);
+    zassert_equal(spo2_window_calculate_float(&dc_window, &dc_window), 0);
+
+    /* No DC level, e.g. no finger */
+    spo2_window_reset(&dc_window);
+    for (int n = 0; n < SPO2_WINDOW_SIZE; n++)
+    {
+        spo2_window_add(&dc_window, 0, 0);
+    }
+    zassert_equal(spo2_window_calculate_fixed(&dc_window, &dc_window), 0);
+    zassert_equal(spo2_window_calculate_float(&dc_window, &dc_window), 0);
+}
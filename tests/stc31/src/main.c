@@ -0,0 +1,149 @@
+#include <zephyr/ztest.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/drivers/i2c.h>
+#include <zephyr/drivers/sensor.h>
+#include <zephyr/sys/byteorder.h>
+
+#include "stc31.h"
+#include "stc31_emul.h"
+
+#define STC31_NODE    DT_NODELABEL(stc31)
+
+static const struct device *const stc31 = DEVICE_DT_GET(STC31_NODE);
+static const struct emul *const stc31_emul = EMUL_DT_GET(STC31_NODE);
+static const struct i2c_dt_spec stc31_i2c = I2C_DT_SPEC_GET(STC31_NODE);
+
+/* Gas ticks of 2 vol% CO2, in the 100 % range set by the driver */
+#define CO2_2_PERCENT_TICKS    (16384 + ((2 * 32768) / 100))
+
+static int stc31_command_write(uint16_t cmd)
+{
+    uint8_t buffer[2];
+
+    sys_put_be16(cmd, buffer);
+
+    return i2c_write_dt(&stc31_i2c, buffer, sizeof(buffer));
+}
+
+/* The read and write ASC state commands share their code, the arguments tell them apart */
+static int stc31_asc_state_write(const uint16_t *state)
+{
+    uint8_t buffer[2 + (STC31_ASC_STATE_WORDS * STC31_WORD_SIZE)];
+
+    sys_put_be16(STC31_CMD_ASC_WRITE_STATE, buffer);
+
+    for (int i = 0; i < STC31_ASC_STATE_WORDS; i++)
+    {
+        uint8_t *word = &buffer[2 + (i * STC31_WORD_SIZE)];
+
+        sys_put_be16(state[i], word);
+        word[2] = stc31_compute_crc(word, 2);
+    }
+
+    return i2c_write_dt(&stc31_i2c, buffer, sizeof(buffer));
+}
+
+static void *stc31_setup(void)
+{
+    zassert_true(device_is_ready(stc31));
+
+    return NULL;
+}
+
+static void stc31_before(void *fixture)
+{
+    static const uint16_t ticks = CO2_2_PERCENT_TICKS;
+
+    ARG_UNUSED(fixture);
+
+    stc31_emul_playback_set(stc31_emul, &ticks, 1);
+}
+
+static void stc31_after(void *fixture)
+{
+    ARG_UNUSED(fixture);
+
+    stc31_emul_playback_set(stc31_emul, NULL, 0);
+}
+
+ZTEST(stc31, test_fetch)
+{
+    struct sensor_value val;
+
+    zassert_ok(sensor_sample_fetch(stc31));
+    zassert_ok(sensor_channel_get(stc31, SENSOR_CHAN_CO2, &val));
+    zassert_equal(val.val1, CO2_2_PERCENT_TICKS);
+}
+
+ZTEST(stc31, test_fetch_after_sleep)
+{
+    struct sensor_value val;
+
+    zassert_ok(stc31_sleep(stc31));
+    zassert_ok(sensor_sample_fetch(stc31));
+    zassert_ok(sensor_channel_get(stc31, SENSOR_CHAN_CO2, &val));
+    zassert_equal(val.val1, CO2_2_PERCENT_TICKS);
+}
+
+/*
+ * Only the address with the write bit wakes the sensor up. After reads
+ * alone, however long, the sensor still sleeps and does not acknowledge a
+ * command.
+ */
+ZTEST(stc31, test_read_does_not_wake)
+{
+    uint8_t buffer[STC31_WORD_SIZE];
+
+    zassert_ok(stc31_sleep(stc31));
+
+    for (int i = 0; i < 3; i++)
+    {
+        zassert_not_ok(i2c_read_dt(&stc31_i2c, buffer, sizeof(buffer)));
+        k_msleep(STC31_WAKE_UP_MS);
+    }
+
+    /* This write only starts the wake-up */
+    zassert_not_ok(stc31_command_write(STC31_CMD_MEASURE_GAS_CONCENTRATION));
+    k_msleep(STC31_WAKE_UP_MS);
+    zassert_ok(stc31_command_write(STC31_CMD_MEASURE_GAS_CONCENTRATION));
+
+    /* The driver still believes the sensor sleeps, its wake-up is harmless */
+    zassert_ok(sensor_sample_fetch(stc31));
+}
+
+ZTEST(stc31, test_asc_state_read)
+{
+    uint16_t expected[STC31_ASC_STATE_WORDS];
+    uint16_t state[STC31_ASC_STATE_WORDS];
+
+    for (int i = 0; i < STC31_ASC_STATE_WORDS; i++)
+    {
+        expected[i] = 0x1000 + (i * 0x0101);
+    }
+
+    zassert_ok(stc31_asc_state_write(expected));
+    zassert_ok(stc31_asc_state_read(stc31, state));
+    zassert_mem_equal(state, expected, sizeof(state));
+}
+
+/* A corrupted word fails the whole readout, wherever it is */
+ZTEST(stc31, test_asc_state_read_crc_error)
+{
+    static const uint8_t corrupt[] = {0, STC31_ASC_STATE_WORDS / 2, STC31_ASC_STATE_WORDS - 1};
+    uint16_t expected[STC31_ASC_STATE_WORDS] = {0};
+    uint16_t state[STC31_ASC_STATE_WORDS];
+
+    zassert_ok(stc31_asc_state_write(expected));
+
+    ARRAY_FOR_EACH(corrupt, i)
+    {
+        stc31_emul_crc_corrupt_set(stc31_emul, corrupt[i]);
+        zassert_equal(stc31_asc_state_read(stc31, state), -EIO, "Word %u", corrupt[i]);
+    }
+
+    /* Only the next readout is corrupted */
+    zassert_ok(stc31_asc_state_read(stc31, state));
+}
+
+ZTEST_SUITE(stc31, NULL, stc31_setup, stc31_before, stc31_after, NULL);